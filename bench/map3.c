@@ -0,0 +1,224 @@
+/*
+ * Microbenchmarks for map3 and map3_sharded, built with -DHAMMER_BUILD_BENCH=ON.
+ *
+ *   hammer_bench_map3 [threads]
+ *
+ * Lookups times random gets against maps the size of the chunks around a
+ * camera, both hits and misses, then every key in the nested order chunks
+ * are requested in. Mixed times a stream of gets, puts and dels
+ * over a fixed key range through map3, through map3_sharded on one thread,
+ * then split across threads (default: 4).
+ */
+#include "hammer/map3.h"
+#include "hammer/time.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LOOKUP_OPS  2000000
+#define LOOKUP_RUNS 5
+#define MIXED_OPS   4000000
+#define MAX_THREADS 64
+
+struct mixed {
+	pthread_t            thread;
+	struct map3         *map;
+	struct map3_sharded *sharded;
+	unsigned             seed;
+	unsigned             get_percent;
+	long                 ops;
+	long                 found;
+};
+
+static void  fill(struct map3 *, int ry, int rrq);
+static void  bench_lookups(int ry, int rrq, int miss);
+static void  bench_scan(int ry, int rrq);
+static void  bench_mixed(unsigned get_percent, size_t threads);
+static void *mixed_run(void *);
+
+/* Numerical Recipes LCG, so every run sees the same keys */
+static inline unsigned
+lcg(unsigned *s)
+{
+	return *s = *s * 1664525u + 1013904223u;
+}
+
+int
+main(int argc, char **argv)
+{
+	size_t threads = argc > 1 ? strtoul(argv[1], NULL, 10) : 4;
+	if (threads < 1 || threads > MAX_THREADS) {
+		fprintf(stderr, "threads must be between 1 and %d\n", MAX_THREADS);
+		return EXIT_FAILURE;
+	}
+
+	printf("Lookups, best of %d, M lookups/s:\n", LOOKUP_RUNS);
+	bench_lookups(1, 10, 0);
+	bench_lookups(1, 10, 1);
+	bench_scan(1, 10);
+	bench_lookups(2, 40, 0);
+	bench_lookups(2, 40, 1);
+	bench_scan(2, 40);
+	bench_lookups(4, 64, 0);
+	bench_lookups(4, 64, 1);
+	bench_scan(4, 64);
+
+	printf("Mixed get/put/del over 32k keys, M ops/s:\n");
+	bench_mixed(90, threads);
+	bench_mixed(50, threads);
+	bench_mixed(10, threads);
+
+	return EXIT_SUCCESS;
+}
+
+/* Fills a map with every key within ry layers and rrq chunks of the origin */
+static void
+fill(struct map3 *m, int ry, int rrq)
+{
+	static int present;
+	map3_create(m);
+	for (int y = -ry;  y <= ry;  ++ y)
+	for (int r = -rrq; r <= rrq; ++ r)
+	for (int q = -rrq; q <= rrq; ++ q)
+		map3_put(m, (map3_key) { y, r, q }, &present);
+}
+
+/*
+ * Looks up random keys in the range filled, or shifted out of it to miss.
+ * Each coordinate comes from the high bits of its own LCG step, the low bits
+ * repeat far too soon and would only ever visit a fraction of the keys.
+ */
+static void
+bench_lookups(int ry, int rrq, int miss)
+{
+	struct map3 m;
+	fill(&m, ry, rrq);
+
+	double best = 0;
+	long found = 0;
+	for (int run = 0; run < LOOKUP_RUNS; ++ run) {
+		unsigned s = 1;
+		found = 0;
+		unsigned long long start = now_ns();
+		for (long i = 0; i < LOOKUP_OPS; ++ i) {
+			int y = (int)((lcg(&s) >> 16) % (2 * ry  + 1)) - ry;
+			int r = (int)((lcg(&s) >> 16) % (2 * rrq + 1)) - rrq;
+			int q = (int)((lcg(&s) >> 16) % (2 * rrq + 1)) - rrq;
+			if (miss)
+				y += 1000;
+			found += map3_get(&m, (map3_key) { y, r, q }) != NULL;
+		}
+		double rate = LOOKUP_OPS / ((now_ns() - start) / 1e3);
+		best = rate > best ? rate : best;
+	}
+	printf("  %7zu entries, %s: %5.1f (found %ld)\n",
+	       m.entry_count, miss ? "misses" : "hits  ", best, found);
+	map3_destroy(&m);
+}
+
+/* Looks up every key filled, y then r then q, until LOOKUP_OPS are done */
+static void
+bench_scan(int ry, int rrq)
+{
+	struct map3 m;
+	fill(&m, ry, rrq);
+
+	double best = 0;
+	long found = 0;
+	long passes = LOOKUP_OPS / m.entry_count + 1;
+	for (int run = 0; run < LOOKUP_RUNS; ++ run) {
+		found = 0;
+		unsigned long long start = now_ns();
+		for (long i = 0; i < passes; ++ i)
+		for (int y = -ry;  y <= ry;  ++ y)
+		for (int r = -rrq; r <= rrq; ++ r)
+		for (int q = -rrq; q <= rrq; ++ q)
+			found += map3_get(&m, (map3_key) { y, r, q }) != NULL;
+		double rate = found / ((now_ns() - start) / 1e3);
+		best = rate > best ? rate : best;
+	}
+	printf("  %7zu entries, scan  : %5.1f (found %ld)\n",
+	       m.entry_count, best, found);
+	map3_destroy(&m);
+}
+
+/*
+ * Times MIXED_OPS operations with get_percent gets, the rest split evenly
+ * between puts and dels.
+ */
+static void
+bench_mixed(unsigned get_percent, size_t threads)
+{
+	struct map3 m;
+	struct map3_sharded sm;
+	struct mixed run[MAX_THREADS];
+	unsigned long long start;
+	double map3_rate, sharded_rate, threaded_rate;
+
+	map3_create(&m);
+	run[0] = (struct mixed) { .map = &m, .seed = 1,
+	                          .get_percent = get_percent, .ops = MIXED_OPS };
+	start = now_ns();
+	mixed_run(&run[0]);
+	map3_rate = MIXED_OPS / ((now_ns() - start) / 1e3);
+	map3_destroy(&m);
+
+	map3_sharded_create(&sm);
+	run[0] = (struct mixed) { .sharded = &sm, .seed = 1,
+	                          .get_percent = get_percent, .ops = MIXED_OPS };
+	start = now_ns();
+	mixed_run(&run[0]);
+	sharded_rate = MIXED_OPS / ((now_ns() - start) / 1e3);
+	map3_sharded_destroy(&sm);
+
+	map3_sharded_create(&sm);
+	start = now_ns();
+	for (size_t i = 0; i < threads; ++ i) {
+		run[i] = (struct mixed) { .sharded = &sm, .seed = i + 1,
+		                          .get_percent = get_percent,
+		                          .ops = MIXED_OPS / threads };
+		if (pthread_create(&run[i].thread, NULL, mixed_run, &run[i])) {
+			fprintf(stderr, "Error creating thread\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (size_t i = 0; i < threads; ++ i)
+		pthread_join(run[i].thread, NULL);
+	threaded_rate = MIXED_OPS / ((now_ns() - start) / 1e3);
+	map3_sharded_destroy(&sm);
+
+	printf("  %2u%% get: map3 %4.1f, sharded %4.1f, sharded %zu threads %4.1f\n",
+	       get_percent, map3_rate, sharded_rate, threads, threaded_rate);
+}
+
+static void *
+mixed_run(void *arg)
+{
+	struct mixed *run = arg;
+	unsigned s = run->seed;
+	unsigned put_percent = (100 - run->get_percent) / 2;
+	run->found = 0;
+	for (long i = 0; i < run->ops; ++ i) {
+		unsigned h = lcg(&s) >> 4;
+		map3_key key = { (int)(h % 64) - 32,
+		                 (int)((h >> 6) % 8),
+		                 (int)((h >> 9) % 64) - 32 };
+		unsigned op = (s >> 24) % 100;
+		if (op < run->get_percent) {
+			void *data = run->sharded ? map3_sharded_get(run->sharded, key)
+			                          : map3_get(run->map, key);
+			run->found += data != NULL;
+		} else if (op < run->get_percent + put_percent) {
+			if (run->sharded)
+				map3_sharded_put(run->sharded, key, run);
+			else
+				map3_put(run->map, key, run);
+		} else {
+			if (run->sharded)
+				map3_sharded_del(run->sharded, key);
+			else
+				map3_del(run->map, key);
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,27 @@
+#ifndef HAMMER_BLUR_H_
+#define HAMMER_BLUR_H_
+
+#include <stddef.h>
+
+/*
+ * How samples beyond the edge of a map are read: either wrapping around to
+ * the opposite side, or repeating the nearest edge sample.
+ */
+enum blur_edge {
+	BLUR_EDGE_WRAP,
+	BLUR_EDGE_CLAMP
+};
+
+/*
+ * Performs an in place separable Gaussian blur, with a kernel 2*radius+1 taps
+ * wide (see GAUSSIANK), of a w by h map. Rows then columns are blurred in
+ * parallel bands with parallel_for(). Columns are blurred in blocks copied
+ * out to a contiguous strip so we never stride through the map.
+ *
+ * Every output is accumulated tap by tap in kernel order, so results are
+ * identical regardless of thread count.
+ */
+void blur_gaussian(float *map, size_t w, size_t h, size_t radius,
+                   enum blur_edge);
+
+#endif /* HAMMER_BLUR_H_ */
@@ -5,12 +5,80 @@
 #include "hammer/pool.h"
 #include "hammer/world/chunk.h"
 #include "hammer/worldgen/region.h"
+#include <deadlock/dl.h>
+#include <stdatomic.h>
 #include <stddef.h>
 
+/* Chunks which may be generating at once */
+#define CHUNKMGR_WORKERS 4
+
+/* Default bytes of chunks held at once, see chunkmgr_set_budget */
+#define CHUNKMGR_DEFAULT_BUDGET (256ull << 20)
+
+/* Chunks per pool page, 2MiB */
+#define CHUNKMGR_POOL_PAGE_LEN 16
+
+/*
+ * Chunks are generated asynchronously by worker tasks. Requests are queued
+ * by priority (lowest first) and handed to idle workers by chunkmgr_update(),
+ * which is also where generated chunks are published to chunk_map. Workers
+ * only ever write their own chunk, so chunk_pool and the request queue are
+ * only touched by the task calling into chunkmgr. chunk_map is sharded so
+ * published chunks may be looked up from any task.
+ *
+ * Finished workers push themselves onto completed, a lock-free stack which
+ * chunkmgr_update() takes wholesale. chunkmgr_destroy() cancels workers
+ * which haven't started yet and only waits for those running, so it doesn't
+ * wait on tasks queued behind the caller when there's a single thread.
+ *
+ * No more than chunk_budget chunks are held or generating at once. Once the
+ * budget is reached, a request is only dispatched after evicting a chunk
+ * farther from the focus than the requested one, by hexagonal distance plus
+ * layers. Their pool pages are freed as they empty. evictions counts every
+ * chunk evicted, so anything derived from chunks knows when to look for
+ * stale entries. It's stored with release ordering after each eviction, so
+ * once an acquire load sees a count, those chunks are gone from chunk_map.
+ *
+ * Evicted chunks leave chunk_map at once, but are kept on retired until a
+ * reader acknowledges their eviction with chunkmgr_ack_evictions(). Chunks
+ * copied out of chunk_map may therefore be read without holding its locks.
+ * Retired chunks don't count against the budget.
+ */
+struct chunkmgr_request {
+	long  cy, cr, cq;
+	float priority;
+};
+
+struct chunkmgr_retired {
+	struct chunk *chunk;
+	size_t        eviction; /* value of evictions once evicted */
+};
+
+struct chunkmgr_task;
+
+struct chunkmgr_worker {
+	struct chunkmgr_task   *task; /* while running */
+	struct chunkmgr        *mgr;
+	struct chunk           *chunk;
+	long                    cy, cr, cq;
+	struct chunkmgr_worker *next; /* completion stack link */
+	int                     running;
+};
+
 struct chunkmgr {
         const struct region *region;
         struct pool chunk_pool;
-        struct map3 chunk_map;
+        struct map3_sharded chunk_map;
+        struct map3 pending_map; /* requested chunks not yet published */
+        struct chunkmgr_request *requests; /* vector heap by priority */
+        struct chunkmgr_worker workers[CHUNKMGR_WORKERS];
+        _Atomic(struct chunkmgr_worker *) completed;
+        struct chunkmgr_worker *publishing; /* taken but not yet published */
+        size_t chunk_budget;
+        long focus[3]; /* (y,r,q) of the chunk we evict farthest from */
+        atomic_size_t evictions; /* written by chunkmgr, read by anyone */
+        atomic_size_t evictions_acked; /* written by the reader */
+        struct chunkmgr_retired *retired; /* vector by eviction */
 };
 
 static inline void
@@ -24,6 +92,34 @@ world_to_chunk(long wy, long wr, long wq, long *cy, long *cr, long *cq)
 void chunkmgr_create(struct chunkmgr *, const struct region *);
 void chunkmgr_destroy(struct chunkmgr *);
 struct chunk *chunkmgr_chunk_at(struct chunkmgr *, long cy, long cr, long cq);
+
+/* Generates a chunk synchronously */
 struct chunk *chunkmgr_create_at(struct chunkmgr *, long cy, long cr, long cq);
 
+/*
+ * Queues a chunk to be generated unless it already exists or is queued.
+ * chunkmgr_clear_requests() drops every request not yet being generated, so
+ * they may be queued again with new priorities.
+ */
+void chunkmgr_request(struct chunkmgr *, long cy, long cr, long cq, float priority);
+void chunkmgr_clear_requests(struct chunkmgr *);
+
+/* Limits the memory held by chunks, evicting farthest first */
+void chunkmgr_set_budget(struct chunkmgr *, size_t bytes);
+void chunkmgr_set_focus(struct chunkmgr *, long cy, long cr, long cq);
+
+/*
+ * Tells chunkmgr that the reader no longer holds any chunk from the first
+ * evictions evictions, which must have been loaded before the reader last
+ * looked at chunk_map. Those chunks are returned to the pool on the next
+ * chunkmgr_update().
+ */
+void chunkmgr_ack_evictions(struct chunkmgr *, size_t evictions);
+
+/*
+ * Publishes generated chunks and hands queued requests to idle workers,
+ * returning early once budget_ns has elapsed. Never waits on a worker.
+ */
+void chunkmgr_update(struct chunkmgr *, unsigned long long budget_ns);
+
 #endif /* HAMMER_CHUNKMGR_H_ */
@@ -22,6 +22,18 @@ struct rtargs {
 	 * Useful for limiting hammer to only a few cores.
 	 */
 	unsigned long tc;
+
+	/*
+	 * headless skips the window and render thread entirely and instead
+	 * generates a single planet from seed and scale, writing each stage
+	 * to the directory out. See hammer/headless.h. seed_set is zero
+	 * unless --seed was passed, every seed is valid.
+	 */
+	int                headless;
+	unsigned long long seed;
+	int                seed_set;
+	unsigned long      scale;
+	const char        *out;
 };
 
 int parse_args(struct rtargs *, int argc, char **argv);
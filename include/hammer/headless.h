@@ -0,0 +1,18 @@
+#ifndef HAMMER_HEADLESS_H_
+#define HAMMER_HEADLESS_H_
+
+#include "hammer/cli.h"
+#include <deadlock/dl.h>
+
+/*
+ * Returns a task which generates a single planet (lithosphere, climate,
+ * stream graph and one region) from the seed and scale in args, writes each
+ * stage to args->out and terminates the scheduler. Once the scheduler
+ * returns, *rc holds zero on success or the errno of the first failure.
+ *
+ * Unlike the appstate system this never touches the window or glthread, so
+ * it may be run on machines without a display or GPU.
+ */
+dltask *headless_runner(const struct rtargs *args, int *rc);
+
+#endif /* HAMMER_HEADLESS_H_ */
@@ -1,25 +1,30 @@
 #ifndef HAMMER_MAP3_H_
 #define HAMMER_MAP3_H_
 
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
 
 /* TODO: benchmark performance of a generic map with hash/eq fn pointers */
 
-#define MAP3_NIL_HASH UINT64_MAX
-
 /* typedef for passing a compound literal key like (map3_key) { i, j, k } */
 typedef int map3_key[3];
 
 struct map3_entry {
 	void *data;
-	uint64_t hash;
-	size_t probe_length;
 	map3_key key;
 };
 
+/*
+ * Robin Hood hashing with metadata kept apart from entries, Swiss table
+ * style. meta[i] is zero while entries[i] is empty, otherwise its high byte
+ * is one plus the distance the entry was probed from its ideal slot and its
+ * low byte is a tag taken from the top of its hash. Probes walk the dense
+ * meta array and only touch an entry once its tag and distance match.
+ */
 struct map3 {
 	struct map3_entry *entries;
+	uint16_t *meta;
 	size_t entries_size;
 	size_t entry_count;
 };
@@ -35,12 +40,47 @@ void  map3_put(struct map3 *, map3_key key, void *);
  * map3_isvalid() may be used to iterate over map3::entries directly. For
  * example:
  *   for (size_t i = 0; i < map3->entries_size; ++ i)
- *     if (map3_isvalid(map3->entries[i]))
- *       process entry
+ *     if (map3_isvalid(map3, i))
+ *       process map3->entries[i]
  */
 static inline int
-map3_isvalid(const struct map3_entry *e) {
-	return e->hash != MAP3_NIL_HASH;
+map3_isvalid(const struct map3 *m, size_t i) {
+	return m->meta[i] != 0;
 }
 
+/*
+ * A map3 which may be used by any number of tasks at once. Keys are split by
+ * hash across MAP3_SHARDS maps, each guarded by its own spin lock, so tasks
+ * only contend when they happen to touch the same shard.
+ *
+ * map3_sharded_get() returns the data as it was while the shard was locked.
+ * Whatever that data points to is for the caller to keep alive.
+ *
+ * map3_sharded_foreach() invokes fn with each entry, one shard at a time
+ * while that shard is locked. fn must not call back into the map, and every
+ * other task touching the shard spins until fn returns, so fn should only
+ * copy out what it needs to work on once the foreach is done.
+ */
+#define MAP3_SHARDS 16
+
+typedef void (*map3_fn)(void *arg, const struct map3_entry *);
+
+struct map3_sharded {
+	struct map3_shard {
+		_Alignas(64)
+		struct map3   map;
+		atomic_flag   lock;
+		atomic_size_t count; /* map.entry_count, readable without lock */
+	} shards[MAP3_SHARDS];
+};
+
+void map3_sharded_create(struct map3_sharded *);
+void map3_sharded_destroy(struct map3_sharded *);
+
+void   map3_sharded_del(struct map3_sharded *, map3_key key);
+void  *map3_sharded_get(struct map3_sharded *, map3_key key);
+void   map3_sharded_put(struct map3_sharded *, map3_key key, void *);
+size_t map3_sharded_count(struct map3_sharded *);
+void   map3_sharded_foreach(struct map3_sharded *, map3_fn, void *arg);
+
 #endif /* HAMMER_MAP3_H_ */
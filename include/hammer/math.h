@@ -3,6 +3,7 @@
 
 #include <assert.h>
 #include <math.h>
+#include <stdint.h>
 
 #ifndef M_PI
 #define M_PI 3.14159265359f
@@ -39,15 +40,47 @@
 static inline unsigned long
 wrapidx(long long index, unsigned long size)
 {
-	while (index < 0)
-		index += size;
-	return index % size;
+	long long r = index % (long long)size;
+	return r < 0 ? r + size : (unsigned long)r;
 }
 
+/*
+ * wrapidx() for a size which is a power of two, 1<<scale, usually a constant
+ * like LITHOSPHERE_SCALE so this compiles down to a single AND. Masking
+ * wraps negative indices too, being two's complement.
+ */
+#define WRAPIDX_POW2(I,SCALE) \
+	((unsigned long)((unsigned long long)(long long)(I) & ((1ull << (SCALE)) - 1)))
+
 static inline float
 signf(float x)
 {
 	return x < 0 ? -1 : x > 0;
 }
 
+static inline unsigned
+popcount64(uint64_t x)
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll(x);
+#else
+	x = x - ((x >> 1) & 0x5555555555555555ull);
+	x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+	return (unsigned)((x * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+/* Index of the lowest set bit of x, which must not be zero */
+static inline unsigned
+ctz64(uint64_t x)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(x);
+#else
+	/* ~x + 1 rather than -x, which MSVC warns about on unsigned types */
+	return popcount64((x & (~x + 1)) - 1);
+#endif
+}
+
 #endif /* HAMMER_MATH_H_ */
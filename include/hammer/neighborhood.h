@@ -1,6 +1,10 @@
 #ifndef HAMMER_NEIGHBORHOOD_H_
 #define HAMMER_NEIGHBORHOOD_H_
 
+#include "hammer/math.h"
+#include <stddef.h>
+#include <stdint.h>
+
 enum moore_neighbor {
 	MOORE_NEIGHBOR_NW,
 	MOORE_NEIGHBOR_N,
@@ -20,4 +24,46 @@ static const int moore_neighbor_offsets[MOORE_NEIGHBORHOOD_SIZE][2] = {
 	{ -1,  1 }, {  0,  1 }, {  1,  1 }
 };
 
+/*
+ * West and east come before north and south, the order plate growth and
+ * temperature flow have always visited them in.
+ */
+enum von_neumann_neighbor {
+	VON_NEUMANN_NEIGHBOR_W,
+	VON_NEUMANN_NEIGHBOR_E,
+	VON_NEUMANN_NEIGHBOR_N,
+	VON_NEUMANN_NEIGHBOR_S,
+	VON_NEUMANN_NEIGHBORHOOD_SIZE
+};
+
+static const int von_neumann_neighbor_offsets[VON_NEUMANN_NEIGHBORHOOD_SIZE][2] = {
+	{ -1,  0 }, {  1,  0 },
+	{  0, -1 }, {  0,  1 }
+};
+
+/*
+ * Sets n to the index of each neighbor of cell (x,y), in the order of the
+ * offset tables above, within a square grid 1<<scale cells along each side
+ * which wraps at its edges.
+ */
+static inline void
+moore_neighbors_pow2(uint32_t n[MOORE_NEIGHBORHOOD_SIZE],
+                     long x, long y, unsigned scale)
+{
+	for (size_t i = 0; i < MOORE_NEIGHBORHOOD_SIZE; ++ i) {
+		n[i] = WRAPIDX_POW2(y + moore_neighbor_offsets[i][1], scale) << scale |
+		       WRAPIDX_POW2(x + moore_neighbor_offsets[i][0], scale);
+	}
+}
+
+static inline void
+von_neumann_neighbors_pow2(uint32_t n[VON_NEUMANN_NEIGHBORHOOD_SIZE],
+                           long x, long y, unsigned scale)
+{
+	for (size_t i = 0; i < VON_NEUMANN_NEIGHBORHOOD_SIZE; ++ i) {
+		n[i] = WRAPIDX_POW2(y + von_neumann_neighbor_offsets[i][1], scale) << scale |
+		       WRAPIDX_POW2(x + von_neumann_neighbor_offsets[i][0], scale);
+	}
+}
+
 #endif /* HAMMER_NEIGHBORHOOD_H_ */
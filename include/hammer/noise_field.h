@@ -0,0 +1,66 @@
+#ifndef HAMMER_NOISE_FIELD_H_
+#define HAMMER_NOISE_FIELD_H_
+
+#include "hammer/opensimplex.h"
+#include <stddef.h>
+
+/*
+ * Seamless noise over a w by h map which wraps at its edges.
+ *
+ * To generate coherent wrapping noise we may project our coordinates onto
+ * unit circles along orthogonal axis.
+ *
+ * Once you've attempted to do this in 2D you'll realize your axis are
+ * warping due to, well, sine and cosine. This would be a fine solution for a
+ * 1D noise image. What you actually need are complementing 3rd and 4th axis,
+ * the same way sine and cosine complement eachother for the 1D case.
+ *
+ * Once we have these cyclical 4D coordinates we can warp, transform, and
+ * scale them just like our linear 2D coordinates.
+ *
+ * Column x maps to (x,z) on a circle of circumference frq and row y maps to
+ * (y,w) on another. Both circles are computed once when the field is
+ * created.
+ */
+struct noise_field {
+	float        *cx, *cz; /* per column */
+	float        *ry, *rw; /* per row */
+	unsigned long w, h;
+};
+
+/*
+ * Domain warped fractal noise evaluated over a noise_field.
+ *
+ * Unless warp is NULL, each of the four coordinates is first displaced by
+ * fbm of the matching warp noise, evaluated at coordinates times warp_scale.
+ * If warp_cascade is set each coordinate is warped by those warped before
+ * it, otherwise all are warped by the original coordinates.
+ *
+ * Each of the count noises in n is then evaluated as fbm at those
+ * coordinates times scale.
+ */
+struct noise_fbm {
+	struct opensimplex *const *warp;
+	float                      warp_scale;
+	int                        warp_oct;
+	float                      warp_per;
+	int                        warp_cascade;
+	struct opensimplex *const *n;
+	size_t                     count;
+	float                      scale;
+	int                        oct;
+	float                      per;
+};
+
+/*
+ * Called with each row of the map once evaluated: rows[k] holds w samples
+ * of noise n[k]. Bands of rows are evaluated in parallel with
+ * parallel_for(), so fn must only write state belonging to row y.
+ */
+typedef void (*noise_field_fn)(void *arg, size_t y, float *const *rows);
+
+void noise_field_create(struct noise_field *, unsigned long w, unsigned long h, float frq);
+void noise_field_destroy(struct noise_field *);
+void noise_field_rows(const struct noise_field *, const struct noise_fbm *, noise_field_fn, void *arg);
+
+#endif /* HAMMER_NOISE_FIELD_H_ */
@@ -1,6 +1,8 @@
 #ifndef HAMMER_OPENSIMPLEX_H_
 #define HAMMER_OPENSIMPLEX_H_
 
+#include <stddef.h>
+
 /*
  * Original OpenSimplex Noise in Java.
  * by Kurt Spencer
@@ -31,4 +33,14 @@ float opensimplex2_fbm(const struct opensimplex *, float, float, int oct, float
 float opensimplex3_fbm(const struct opensimplex *, float, float, float, int oct, float per);
 float opensimplex4_fbm(const struct opensimplex *, float, float, float, float, int oct, float per);
 
+/*
+ * Evaluates fractal noise at each of n points, writing to out, using the
+ * widest vector instructions the CPU supports. Results are the same on every
+ * CPU, and agree with the scalar variants above to within a few ULP. out
+ * must not overlap any input.
+ */
+void opensimplex2_fbm_batch(const struct opensimplex *, const float *x, const float *y, float *out, size_t n, int oct, float per);
+void opensimplex3_fbm_batch(const struct opensimplex *, const float *x, const float *y, const float *z, float *out, size_t n, int oct, float per);
+void opensimplex4_fbm_batch(const struct opensimplex *, const float *x, const float *y, const float *z, const float *w, float *out, size_t n, int oct, float per);
+
 #endif /* HAMMER_OPENSIMPLEX_H_ */
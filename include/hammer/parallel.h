@@ -0,0 +1,23 @@
+#ifndef HAMMER_PARALLEL_H_
+#define HAMMER_PARALLEL_H_
+
+#include <stddef.h>
+
+/*
+ * parallel_for() splits the range [0,count) into bands of at most grain
+ * elements and invokes fn(arg, begin, end) once per band on the deadlock
+ * scheduler, returning once every band has completed.
+ *
+ * The calling task claims bands alongside the helper tasks it spawns, and
+ * cancels any helper which has not started by the time the bands run out, so
+ * this may be called from within any task without deadlocking, even when the
+ * scheduler only has a single thread.
+ *
+ * Bands are processed in no particular order. fn must only write state owned
+ * by its band.
+ */
+typedef void (*parallel_fn)(void *arg, size_t begin, size_t end);
+
+void parallel_for(size_t count, size_t grain, parallel_fn fn, void *arg);
+
+#endif /* HAMMER_PARALLEL_H_ */
@@ -11,6 +11,10 @@
  * This is a crude implementation of:
  *  Robert Bridson, 2007. "Fast Poisson Disk Sampling in Arbitrary
  *  Dimensions." SIGGRAPH '07
+ *
+ * The domain wraps at its edges. Tiles of the domain are sampled in parallel
+ * with parallel_for(), and the result depends only upon the seed, never
+ * the number of threads.
  */
 void poisson(float **pt, size_t *ptsz, uint64_t seed, float r, float w, float h);
 
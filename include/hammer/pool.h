@@ -3,25 +3,36 @@
 
 #include <stddef.h>
 
-#define POOL_PAGE_SIZE 512 /* 16MiB */
+#define POOL_PAGE_SIZE 512 /* structs per page, unless created paged */
 
 /*
+ * Structs are allocated a page at a time. Each page keeps its own free list:
  * freehead points to uninitialized data which can be cast to a pointer to the
- * next unitialized data. This singly linked list continues until all data are
- * utilized, then more is allocated. When data is returned it is added to this
- * free list.
+ * next unitialized data, until the list runs out. When data is returned it is
+ * added to the free list of the page it came from.
  *
- * TOOD: This pool only ever grows, but it wouldn't be too hard to free a page
- * at a time when the entire page is free.
+ * Pages are mapped directly from the OS. We always take from the first page
+ * with room, so as a pool shrinks its later pages drain. Once every struct of
+ * a page has been returned the page is unmapped, except for one empty page we
+ * hold onto so a pool hovering around a page boundary doesn't thrash the OS.
  */
-struct pool {
-	void **pages;
+struct pool_page {
+	char  *mem;
 	void  *freehead;
+	size_t taken;
+};
+
+struct pool {
+	struct pool_page *pages;
 	size_t structsize;
+	size_t page_len;    /* structs per page */
 	size_t pages_count;
+	size_t first_free;  /* no page before this one has room */
+	int    has_empty;   /* whether we're holding an empty page */
 };
 
 void  pool_create (struct pool *, size_t structsize);
+void  pool_create_paged(struct pool *, size_t structsize, size_t page_len);
 void  pool_destroy(struct pool *);
 void *pool_take   (struct pool *);
 void  pool_give   (struct pool *, void *);
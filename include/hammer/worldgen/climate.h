@@ -41,10 +41,10 @@ lerp_climate_layer(const float layer[CLIMATE_AREA],
 	assert(scale >= 1);
 	float cx = x / scale;
 	float cy = y / scale;
-	long cxf = wrapidx(floorf(cx), CLIMATE_LEN);
-	long cxc = wrapidx( ceilf(cx), CLIMATE_LEN);
-	long cyf = wrapidx(floorf(cy), CLIMATE_LEN);
-	long cyc = wrapidx( ceilf(cy), CLIMATE_LEN);
+	long cxf = WRAPIDX_POW2(floorf(cx), CLIMATE_SCALE);
+	long cxc = WRAPIDX_POW2( ceilf(cx), CLIMATE_SCALE);
+	long cyf = WRAPIDX_POW2(floorf(cy), CLIMATE_SCALE);
+	long cyc = WRAPIDX_POW2( ceilf(cy), CLIMATE_SCALE);
 	float uff = layer[cyf * CLIMATE_LEN + cxf];
 	float ufc = layer[cyf * CLIMATE_LEN + cxc];
 	float ucf = layer[cyc * CLIMATE_LEN + cxf];
@@ -60,7 +60,15 @@ void region_create(struct region *,
 void region_destroy(struct region *);
 void region_erode(struct region *);
 
-/* Performs interpolation */
+/* Bilinear interpolation of stone height at (x,z), which must be in region */
 float region_stone_at(const struct region *, float x, float z);
 
+/*
+ * Fills heights with the stone height beneath each of rows by cols block
+ * columns, starting at axial coordinate (r0,q0) and stored row major. Columns
+ * outside the region have no stone and are -INFINITY.
+ */
+void region_sample_columns(const struct region *, long r0, long q0,
+                           size_t rows, size_t cols, float *heights);
+
 #endif /* HAMMER_WORLDGEN_REGION_H_ */
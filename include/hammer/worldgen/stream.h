@@ -32,7 +32,6 @@ struct stream_node {
 	float precip;
 	float uplift;
 	float drainage;
-	unsigned char unwound;
 	// TODO: local k, m, n, talus?
 };
 
@@ -52,26 +51,49 @@ struct stream_tri {
 };
 
 struct stream_tree {
-	uint32_t *border_edges; /* vector */
 	uint32_t lake_receiver;
 	uint32_t node_receiver;
 	uint32_t root;
 	float pass_to_receiver;
-	int in_queue;
 	int is_lake;
 };
 
+/*
+ * Uniform grid over the stream graph, built once nodes and triangles are
+ * created, since neither moves. Each cell lists the nodes within it and the
+ * triangles whose bounding box overlaps it, in ascending index order. Cell
+ * lists are stored contiguously: cell i owns [start[i],start[i+1]).
+ */
+#define STREAM_INDEX_CELL 8 /* stream graph units along each side */
+
+struct stream_index {
+	uint32_t *node_start;
+	uint32_t *nodes;
+	uint32_t *tri_start;
+	uint32_t *tris;
+	unsigned  len; /* cells along each axis */
+};
+
 struct stream_graph {
 	struct stream_node *nodes;
 	struct stream_arc  *arcs;  /* index is source node */
 	struct stream_edge *edges; /* vector */
 	struct stream_tri  *tris;  /* vector */
 	struct stream_tree *trees; /* vector */
+	struct stream_index index;
+	/*
+	 * Neighbors of each node, in ascending index order, stored
+	 * contiguously: node i owns [adjacency_start[i],adjacency_start[i+1]).
+	 */
+	uint32_t           *adjacency_start;
+	uint32_t           *adjacency;
 	uint32_t            node_count;
 	unsigned            generation;
 	unsigned            size;
 };
 
+#define STREAM_NO_TRI ((uint32_t)-1)
+
 void stream_graph_create(struct stream_graph *,
                          const struct climate *,
                          unsigned long long seed,
@@ -79,6 +101,38 @@ void stream_graph_create(struct stream_graph *,
 void stream_graph_destroy(struct stream_graph *);
 void stream_graph_update(struct stream_graph *);
 
+/*
+ * Spatial queries. Coordinates may lie outside [0,size) and wrap, as do
+ * distances and rectangles.
+ *
+ * stream_graph_locate() returns the triangle containing (x,y), or
+ * STREAM_NO_TRI, and if w is not NULL fills in the barycentric weights of its
+ * nodes.
+ *
+ * stream_graph_nearest() writes the indices of the (at most) k nodes nearest
+ * (x,y), closest first, to nodes and returns how many were written.
+ *
+ * stream_graph_tris_in_rect() pushes the index of every triangle whose
+ * bounding box overlaps the rectangle onto the tris vector, once, in
+ * ascending order.
+ */
+uint32_t stream_graph_locate(const struct stream_graph *,
+                             float x, float y, float w[3]);
+size_t stream_graph_nearest(const struct stream_graph *,
+                            float x, float y,
+                            size_t k, uint32_t *nodes);
+void stream_graph_tris_in_rect(const struct stream_graph *,
+                               float left, float top,
+                               float width, float height,
+                               uint32_t **tris);
+
+/*
+ * Copies the nodes of a triangle, with the second and third projected across
+ * the map border where necessary to lie nearest the first.
+ */
+void stream_graph_tri_nodes(const struct stream_graph *, uint32_t ti,
+                            struct stream_node n[3]);
+
 /* fast wrap since size is power of two */
 #define STREAM_WRAP(S, X) (((X) + (S)->size) & ((S)->size - 1))
 
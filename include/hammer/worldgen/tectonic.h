@@ -32,6 +32,7 @@ _Static_assert(MAX_SEGMENT_COUNT * MAX_SEGMENT_COUNT % 8 == 0);
 
 #define NO_PLATE   ((uint32_t)-1)
 #define NO_SEGMENT ((uint16_t)-1)
+#define NO_OCCUPANCY ((uint32_t)-1)
 
 /*
  * An intra-plate collision identifies the lithosphere space coordinates of
@@ -55,12 +56,23 @@ struct segment {
 	uint32_t area;
 	uint32_t left, top;
 	uint32_t w, h;
+	/*
+	 * Offset of this segment's occupancy bitmap within plate::occupancy,
+	 * or NO_OCCUPANCY if it hasn't been built since the segment last
+	 * changed. spilled is set once a collision adds a cell outside of the
+	 * bounding box, which the bitmap can't represent.
+	 */
+	uint32_t occupancy;
 	uint16_t id;
+	uint8_t  spilled;
 };
 
 /*
  * I've concocted these three fields to replace mass and extract rock
  * composition information. Mass of a cell is the sum of these fields.
+ *
+ * Plates and the lithosphere keep that sum alongside their composition maps
+ * in a total_mass array, which must be updated whenever composition changes.
  */
 struct tectonic_mass_composition {
 	float sediment;
@@ -68,8 +80,27 @@ struct tectonic_mass_composition {
 	float igneous;
 };
 
+/*
+ * Plate mass is stored in square tiles which are only allocated once mass
+ * lands in them, so a plate costs memory proportional to its area rather than
+ * the area of the whole lithosphere. A missing tile has no mass and no
+ * segments.
+ */
+#define PLATE_TILE_SCALE 6
+#define PLATE_TILE_LEN   (1<<PLATE_TILE_SCALE)
+#define PLATE_TILE_AREA  (PLATE_TILE_LEN * PLATE_TILE_LEN)
+#define PLATE_TILES_LEN  (LITHOSPHERE_LEN / PLATE_TILE_LEN)
+#define PLATE_TILES_AREA (PLATE_TILES_LEN * PLATE_TILES_LEN)
+
+struct plate_tile {
+	struct tectonic_mass_composition mass[PLATE_TILE_AREA];
+	float total_mass[PLATE_TILE_AREA];
+	uint16_t in_segment[PLATE_TILE_AREA];
+};
+
 struct plate {
 	struct segment *segments;
+	uint64_t *occupancy; /* vector, see segment::occupancy */
 	/*
 	 * The original paper must have updated left/top whenever a plate
 	 * shifted. This works when you have a 2D map of mass only as large as
@@ -81,7 +112,7 @@ struct plate {
 	 */
 	float tvx, tvy;
 	float tx, ty;
-	struct tectonic_mass_composition mass[LITHOSPHERE_AREA];
+	struct plate_tile *tiles[PLATE_TILES_AREA];
 	/*
 	 * Do NOT attempt to define this using four points. Trust me. It's a
 	 * total shitshow when you're dealing with iterating over wrapping
@@ -90,7 +121,43 @@ struct plate {
 	 */
 	uint32_t left, top;
 	uint32_t w, h;
-	uint16_t in_segment[LITHOSPHERE_AREA];
+	/*
+	 * Lithosphere to plate space coordinate maps, only valid while
+	 * blitting. blit_run_end[x] is the first lithosphere column after x
+	 * which maps onto a different column of tiles.
+	 */
+	uint32_t blit_px[LITHOSPHERE_LEN];
+	uint32_t blit_py[LITHOSPHERE_LEN];
+	uint16_t blit_run_end[LITHOSPHERE_LEN];
+};
+
+/*
+ * Plates are blitted onto the lithosphere in parallel bands of rows. Each
+ * band records collisions, along with the segment pair that collided, into
+ * its own lists which are then merged into lithosphere::collisions in the
+ * same order a serial blit would have produced them.
+ */
+#define LITHOSPHERE_BLIT_BAND_ROWS 32
+#define LITHOSPHERE_BLIT_BANDS (LITHOSPHERE_LEN / LITHOSPHERE_BLIT_BAND_ROWS)
+
+struct blit_band {
+	struct collision *collisions;    /* vector */
+	uint16_t         *segment_pairs; /* vector, parallel to collisions */
+	uint8_t           collision_set[COLLISION_SET_BYTES];
+};
+
+/*
+ * Segment overlap is memoized per pair of segment IDs until the next step or
+ * segment merge, whichever comes first. An entry is only valid while its
+ * stamp matches lithosphere::overlap_stamp.
+ */
+#define OVERLAP_MEMO_BITS 12
+#define OVERLAP_MEMO_SIZE (1 << OVERLAP_MEMO_BITS)
+
+struct overlap_memo {
+	uint32_t key;
+	uint32_t stamp;
+	uint32_t overlap;
 };
 
 struct lithosphere {
@@ -98,10 +165,14 @@ struct lithosphere {
 	struct plate *plates;
 	WELL512  rng;
 	struct tectonic_mass_composition mass[LITHOSPHERE_AREA];
+	float total_mass[LITHOSPHERE_AREA];
 	uint32_t generation;
 	uint32_t owner[LITHOSPHERE_AREA];
 	uint32_t prev_owner[LITHOSPHERE_AREA];
 	uint8_t  collision_set[COLLISION_SET_BYTES];
+	struct blit_band blit_bands[LITHOSPHERE_BLIT_BANDS];
+	uint32_t overlap_stamp;
+	struct overlap_memo overlap_memo[OVERLAP_MEMO_SIZE];
 };
 
 void lithosphere_create(struct lithosphere *, const struct world_opts *);
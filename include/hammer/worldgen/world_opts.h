@@ -78,6 +78,39 @@ struct world_opts {
 	} tectonic;
 };
 
+/*
+ * Fills opts with the default generation parameters for a given seed and
+ * scale. Shared by the server configuration menu and headless generation.
+ */
+static inline void
+world_opts_default(struct world_opts *opts,
+                   unsigned long long seed,
+                   unsigned           scale)
+{
+	*opts = (struct world_opts) {
+		.seed = seed,
+		.scale = scale,
+		.tectonic = {
+			.collision_xfer   = 0.035f,
+			.subduction_xfer  = 0.025f,
+			.merge_ratio      = 0.2f,
+			.rift_mass        = 0.9f,
+			.volcano_mass     = 15.0f,
+			.volcano_chance   = 0.01f,
+			.continent_talus  = 0.05f,
+			.ocean_talus      = 0.025f,
+			.generation_steps = 100,
+			.generations      = 2,
+			.min_plates       = 10,
+			.max_plates       = 25,
+			.segment_radius   = 2,
+			.divergent_radius = 5,
+			.erosion_ticks    = 5,
+			.rift_ticks       = 60
+		}
+	};
+}
+
 static inline unsigned long
 world_opts_stream_graph_size(const struct world_opts *opts)
 {
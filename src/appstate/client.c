@@ -5,21 +5,40 @@
 #include "hammer/hexagon.h"
 #include "hammer/math.h"
 #include "hammer/server.h"
+#include "hammer/vector.h"
 #include "hammer/window.h"
 #include <cglm/cam.h>
 #include <cglm/euler.h>
+#include <stdlib.h>
 
 #define MIN_PITCH (-M_PI/2+0.001f)
 #define MAX_PITCH ( M_PI/2-0.001f)
 
+/* Chunks requested around the camera along y, and along r and q */
+#define CHUNK_RANGE_Y  1
+#define CHUNK_RANGE_RQ 10
+
+/* Time spent publishing and dispatching chunks each frame */
+#define CHUNK_BUDGET_NS 2000000ull
+
 /* TODO shouldn't reference server */
 
 dltask appstate_client_frame;
 
+/* A published chunk without a mesh, copied out of chunk_map */
+struct client_unmeshed {
+	map3_key key;
+	const struct chunk *chunk;
+};
+
 static struct {
 	struct chunkmgr chunkmgr;
 	struct map3 chunkmesh_map;
 	struct pool chunkmesh_pool;
+	struct client_unmeshed *unmeshed; /* vector, only used by GL thread */
+	long chunk_origin[3]; /* chunk (y,r,q) containing camera */
+	int chunk_origin_valid;
+	size_t chunkmesh_evictions; /* chunkmgr evictions seen by meshes */
 	struct {
 		vec3 position;
 		vec3 rotation;
@@ -31,8 +50,11 @@ static struct {
 } client;
 
 static void client_frame_async(DL_TASK_ARGS);
+static void client_request_chunks(long cy, long cr, long cq);
 static int client_gl_setup(void *);
 static int client_gl_frame(void *);
+static void client_gl_find_unmeshed(void *, const struct map3_entry *);
+static void client_gl_drop_evicted_meshes(void);
 
 void
 appstate_client_setup(void)
@@ -41,6 +63,9 @@ appstate_client_setup(void)
 	chunkmgr_create(&client.chunkmgr, &server.world.region);
 	map3_create(&client.chunkmesh_map);
 	pool_create(&client.chunkmesh_pool, sizeof(struct chunkmesh));
+	client.unmeshed = NULL;
+	client.chunk_origin_valid = 0;
+	client.chunkmesh_evictions = 0;
 
 	float half = server.world.region.size / 2;
 	glm_vec3_copy((vec3) { half, 50, half }, client.camera.position);
@@ -57,6 +82,7 @@ void
 appstate_client_teardown(void)
 {
 	chunkmgr_destroy(&client.chunkmgr);
+	vector_free(&client.unmeshed);
 	pool_destroy(&client.chunkmesh_pool);
 	map3_destroy(&client.chunkmesh_map);
 }
@@ -71,28 +97,48 @@ client_frame_async(DL_TASK_ARGS)
 		return;
 	}
 
-	/* DEBUG: Generate chunks around camera for */
+	/*
+	 * Chunks around the camera are only requested when the camera enters
+	 * another chunk, nearest first, and are generated in the background.
+	 */
 	float hex_pos[2];
 	hex_pixel_to_axial(BLOCK_HEX_SIZE,
 	                   client.camera.position[0],
 	                   client.camera.position[2],
 	                   hex_pos+0, hex_pos+1);
-	fprintf(stderr, "(y,r,q)\t(%ld,%ld,%ld)\n",
-	        (long)(client.camera.position[1] / CHUNK_LEN),
-	        (long)(hex_pos[1] / CHUNK_LEN),
-	        (long)(hex_pos[0] / CHUNK_LEN));
-	float miny = client.camera.position[1] / CHUNK_LEN - 1;
-	float maxy = client.camera.position[1] / CHUNK_LEN + 1;
-	float maxr = hex_pos[1] / CHUNK_LEN + 10;
-	float minr = hex_pos[1] / CHUNK_LEN - 10;
-	float maxq = hex_pos[0] / CHUNK_LEN + 10;
-	float minq = hex_pos[0] / CHUNK_LEN - 10;
-	for (long y = miny; y <= maxy; ++ y)
-	for (long r = minr; r <= maxr; ++ r)
-	for (long q = minq; q <= maxq; ++ q) {
-		if (chunkmgr_chunk_at(&client.chunkmgr, y, r, q) == NULL) {
-			chunkmgr_create_at(&client.chunkmgr, y, r, q);
-		}
+	long cy = floorf(client.camera.position[1] / CHUNK_LEN);
+	long cr = floorf(hex_pos[1] / CHUNK_LEN);
+	long cq = floorf(hex_pos[0] / CHUNK_LEN);
+	if (!client.chunk_origin_valid ||
+	    cy != client.chunk_origin[0] ||
+	    cr != client.chunk_origin[1] ||
+	    cq != client.chunk_origin[2])
+	{
+		fprintf(stderr, "(y,r,q)\t(%ld,%ld,%ld)\n", cy, cr, cq);
+		client_request_chunks(cy, cr, cq);
+	}
+	chunkmgr_update(&client.chunkmgr, CHUNK_BUDGET_NS);
+}
+
+static void
+client_request_chunks(long cy, long cr, long cq)
+{
+	client.chunk_origin[0] = cy;
+	client.chunk_origin[1] = cr;
+	client.chunk_origin[2] = cq;
+	client.chunk_origin_valid = 1;
+	chunkmgr_set_focus(&client.chunkmgr, cy, cr, cq);
+
+	/* Reprioritize whatever is still queued by distance to the camera */
+	chunkmgr_clear_requests(&client.chunkmgr);
+	for (long y = cy - CHUNK_RANGE_Y;  y <= cy + CHUNK_RANGE_Y;  ++ y)
+	for (long r = cr - CHUNK_RANGE_RQ; r <= cr + CHUNK_RANGE_RQ; ++ r)
+	for (long q = cq - CHUNK_RANGE_RQ; q <= cq + CHUNK_RANGE_RQ; ++ q) {
+		/* Hexagonal distance in chunks, plus layers */
+		long dr = r - cr;
+		long dq = q - cq;
+		float d = (labs(dr) + labs(dq) + labs(dr + dq)) / 2 + labs(y - cy);
+		chunkmgr_request(&client.chunkmgr, y, r, q, d);
 	}
 }
 
@@ -112,16 +158,27 @@ client_gl_frame(void *_)
 	client.camera.rotation[0] -= window.motion_y / 600.0f;
 	client.camera.rotation[0] = CLAMP(client.camera.rotation[0], MIN_PITCH, MAX_PITCH);
 
-	/* DEBUG: Mesh out debug chunks */
-	size_t chunkmgr_entry_count = client.chunkmgr.chunk_map.entries_size;
-	for (size_t i = 0; i < chunkmgr_entry_count; ++ i) {
-		struct map3_entry *e = &client.chunkmgr.chunk_map.entries[i];
-		if (!map3_isvalid(e) || map3_get(&client.chunkmesh_map, e->key) != NULL)
-			continue;
+	/*
+	 * DEBUG: Mesh out debug chunks. Chunks without a mesh are copied out
+	 * of chunk_map under its locks and meshed after. Any chunk evicted
+	 * since evictions was loaded is kept alive until the next frame
+	 * acknowledges it.
+	 */
+	size_t evictions = atomic_load_explicit(&client.chunkmgr.evictions,
+	                                        memory_order_acquire);
+	vector_clear(&client.unmeshed);
+	map3_sharded_foreach(&client.chunkmgr.chunk_map, client_gl_find_unmeshed, NULL);
+	for (size_t i = 0; i < vector_size(client.unmeshed); ++ i) {
+		struct client_unmeshed *u = &client.unmeshed[i];
 		struct chunkmesh *mesh = pool_take(&client.chunkmesh_pool);
-		chunkmesh_gl_create(mesh, e->data, e->key[0], e->key[1], e->key[2]);
-		map3_put(&client.chunkmesh_map, e->key, mesh);
+		chunkmesh_gl_create(mesh, u->chunk, u->key[0], u->key[1], u->key[2]);
+		map3_put(&client.chunkmesh_map, u->key, mesh);
 	}
+	if (client.chunkmesh_evictions != evictions) {
+		client.chunkmesh_evictions = evictions;
+		client_gl_drop_evicted_meshes();
+	}
+	chunkmgr_ack_evictions(&client.chunkmgr, evictions);
 
 	/* TODO: Belongs elsewhere */
 	vec3 opengl_up = { 0, 1, 0 };
@@ -186,10 +243,9 @@ client_gl_frame(void *_)
 	/* Render chunks */
 	size_t mesh_count = client.chunkmesh_map.entries_size;
 	for (size_t i = 0; i < mesh_count; ++ i) {
-		struct map3_entry *e = &client.chunkmesh_map.entries[i];
-		if (!map3_isvalid(e))
+		if (!map3_isvalid(&client.chunkmesh_map, i))
 			continue;
-		struct chunkmesh *m = e->data;
+		struct chunkmesh *m = client.chunkmesh_map.entries[i].data;
 		glBindVertexArray(m->vao);
 		glDrawArrays(GL_TRIANGLES, 0, m->vc);
 	}
@@ -197,3 +253,36 @@ client_gl_frame(void *_)
 	window_submitframe();
 	return window.should_close;
 }
+
+static void
+client_gl_find_unmeshed(void *_, const struct map3_entry *e)
+{
+	map3_key key = { e->key[0], e->key[1], e->key[2] };
+	if (map3_get(&client.chunkmesh_map, key) != NULL)
+		return;
+	vector_push(&client.unmeshed, (struct client_unmeshed) {
+		{ key[0], key[1], key[2] }, e->data
+	});
+}
+
+static void
+client_gl_drop_evicted_meshes(void)
+{
+	struct map3 *meshes = &client.chunkmesh_map;
+	for (size_t i = 0; i < meshes->entries_size; ) {
+		if (map3_isvalid(meshes, i)) {
+			map3_key key = { meshes->entries[i].key[0],
+			                 meshes->entries[i].key[1],
+			                 meshes->entries[i].key[2] };
+			struct chunkmesh *mesh = meshes->entries[i].data;
+			if (!chunkmgr_chunk_at(&client.chunkmgr, key[0], key[1], key[2])) {
+				chunkmesh_gl_destroy(mesh);
+				pool_give(&client.chunkmesh_pool, mesh);
+				/* Deleting shifts the next entry back into i */
+				map3_del(meshes, key);
+				continue;
+			}
+		}
+		++ i;
+	}
+}
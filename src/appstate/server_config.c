@@ -32,28 +32,7 @@ void
 appstate_server_config_setup(void)
 {
 	appstate_server_config_frame = DL_TASK_INIT(server_config_frame_async);
-	server.world.opts = (struct world_opts) {
-		.seed = random_seed(),
-		.scale = 3,
-		.tectonic = {
-			.collision_xfer   = 0.035f,
-			.subduction_xfer  = 0.025f,
-			.merge_ratio      = 0.2f,
-			.rift_mass        = 0.9f,
-			.volcano_mass     = 15.0f,
-			.volcano_chance   = 0.01f,
-			.continent_talus  = 0.05f,
-			.ocean_talus      = 0.025f,
-			.generation_steps = 100,
-			.generations      = 2,
-			.min_plates       = 10,
-			.max_plates       = 25,
-			.segment_radius   = 2,
-			.divergent_radius = 5,
-			.erosion_ticks    = 5,
-			.rift_ticks       = 60
-		}
-	};
+	world_opts_default(&server.world.opts, random_seed(), 3);
 	glthread_execute(server_config_gl_setup, NULL);
 	snprintf(server_config.seed_edit_buf, NUM_EDIT_BUFFER_LEN,
 	         "%llu", server.world.opts.seed);
@@ -154,9 +154,7 @@ planet_gen_iter_img_lithosphere(struct planet_gen_iter_async *async)
 	struct lithosphere *l = server.planet.lithosphere;
 	/* Blue below sealevel, green to red continent altitude */
 	for (size_t i = 0; i < LITHOSPHERE_AREA; ++ i) {
-		float total_mass = l->mass[i].sediment +
-		                   l->mass[i].metamorphic +
-		                   l->mass[i].igneous;
+		float total_mass = l->total_mass[i];
 		if (total_mass > TECTONIC_CONTINENT_MASS) {
 			float h = total_mass - TECTONIC_CONTINENT_MASS;
 			async->iteration_render[i*3+0] = 30 + 95 * MIN(4,h) / 3;
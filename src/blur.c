@@ -0,0 +1,116 @@
+#include "hammer/blur.h"
+#include "hammer/math.h"
+#include "hammer/mem.h"
+#include "hammer/parallel.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Rows per band during the row pass, columns per strip in the column pass */
+#define BLUR_ROW_BAND    16
+#define BLUR_COLUMN_BAND 64
+
+struct blur_job {
+	float *map;
+	size_t w, h;
+	size_t radius;
+	enum blur_edge edge;
+	const float *kernel;
+};
+
+static size_t blur_edge_index(long long i, size_t n, enum blur_edge);
+static void blur_convolve(float *restrict out, const float *restrict in,
+                          size_t len, size_t stride,
+                          const float *kernel, size_t taps);
+static void blur_rows(void *, size_t y0, size_t y1);
+static void blur_columns(void *, size_t x0, size_t x1);
+
+void
+blur_gaussian(float *map, size_t w, size_t h, size_t radius,
+              enum blur_edge edge)
+{
+	const size_t taps = 2 * radius + 1;
+	float kernel[taps];
+	GAUSSIANK(kernel, taps);
+
+	struct blur_job job = {
+		.map = map,
+		.w = w,
+		.h = h,
+		.radius = radius,
+		.edge = edge,
+		.kernel = kernel
+	};
+	parallel_for(h, BLUR_ROW_BAND, blur_rows, &job);
+	parallel_for(w, BLUR_COLUMN_BAND, blur_columns, &job);
+}
+
+static size_t
+blur_edge_index(long long i, size_t n, enum blur_edge edge)
+{
+	if (edge == BLUR_EDGE_WRAP)
+		return wrapidx(i, n);
+	return i < 0 ? 0 : (size_t)i >= n ? n - 1 : (size_t)i;
+}
+
+/*
+ * out[x] is the sum of kernel[g] * in[g * stride + x] over every tap g. Taps
+ * are the outer loop so that the inner loop runs over contiguous memory and
+ * vectorizes, while each output still accumulates in kernel order.
+ */
+static void
+blur_convolve(float *restrict out, const float *restrict in,
+              size_t len, size_t stride,
+              const float *kernel, size_t taps)
+{
+	for (size_t x = 0; x < len; ++ x)
+		out[x] = 0;
+	for (size_t g = 0; g < taps; ++ g) {
+		const float *src = in + g * stride;
+		for (size_t x = 0; x < len; ++ x)
+			out[x] += kernel[g] * src[x];
+	}
+}
+
+static void
+blur_rows(void *arg, size_t y0, size_t y1)
+{
+	const struct blur_job *job = arg;
+	const size_t taps = 2 * job->radius + 1;
+	/* Row padded with radius samples beyond each edge */
+	float *line = xmalloc((job->w + taps - 1) * sizeof(*line));
+	float *sum = xmalloc(job->w * sizeof(*sum));
+	for (size_t y = y0; y < y1; ++ y) {
+		float *row = job->map + y * job->w;
+		for (size_t x = 0; x < job->w + taps - 1; ++ x) {
+			long long sx = (long long)x - job->radius;
+			line[x] = row[blur_edge_index(sx, job->w, job->edge)];
+		}
+		blur_convolve(sum, line, job->w, 1, job->kernel, taps);
+		memcpy(row, sum, job->w * sizeof(*row));
+	}
+	free(sum);
+	free(line);
+}
+
+static void
+blur_columns(void *arg, size_t x0, size_t x1)
+{
+	const struct blur_job *job = arg;
+	const size_t taps = 2 * job->radius + 1;
+	const size_t sw = x1 - x0;
+	/* Columns [x0,x1) padded with radius samples beyond each edge */
+	float *strip = xmalloc((job->h + taps - 1) * sw * sizeof(*strip));
+	float *sum = xmalloc(sw * sizeof(*sum));
+	for (size_t y = 0; y < job->h + taps - 1; ++ y) {
+		long long sy = (long long)y - job->radius;
+		size_t row = blur_edge_index(sy, job->h, job->edge);
+		memcpy(strip + y * sw, job->map + row * job->w + x0,
+		       sw * sizeof(*strip));
+	}
+	for (size_t y = 0; y < job->h; ++ y) {
+		blur_convolve(sum, strip + y * sw, sw, sw, job->kernel, taps);
+		memcpy(job->map + y * job->w + x0, sum, sw * sizeof(*sum));
+	}
+	free(sum);
+	free(strip);
+}
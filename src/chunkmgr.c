@@ -1,59 +1,373 @@
 #include "hammer/chunkmgr.h"
 #include "hammer/hexagon.h"
 #include "hammer/math.h"
+#include "hammer/time.h"
+#include "hammer/vector.h"
 #include <stdlib.h>
 
+static void chunkmgr_fill(const struct region *, struct chunk *,
+                          long cy, long cr, long cq);
+static void chunkmgr_worker_async(DL_TASK_ARGS);
+static struct chunkmgr_task *chunkmgr_task_take(void);
+static void chunkmgr_publish(struct chunkmgr *, struct chunkmgr_worker *);
+static void request_push(struct chunkmgr_request **, struct chunkmgr_request);
+static struct chunkmgr_request request_pop(struct chunkmgr_request *);
+static void chunkmgr_reclaim(struct chunkmgr *);
+static int chunkmgr_make_room(struct chunkmgr *, const struct chunkmgr_request *);
+static void chunkmgr_find_farthest(void *, const struct map3_entry *);
+static long chunkmgr_distance(const struct chunkmgr *, long cy, long cr, long cq);
+
+/* Worker task slots shared by every chunkmgr */
+#define CHUNKMGR_TASKS (4 * CHUNKMGR_WORKERS)
+
+/*
+ * Worker tasks live in .bss rather than in the chunkmgr, like parallel_for's
+ * helpers, because chunkmgr_destroy() may return while a worker it cancelled
+ * is still queued. That task will eventually be invoked, find no worker, and
+ * mark itself free again.
+ */
+static struct chunkmgr_task {
+	dltask task;
+	_Atomic(struct chunkmgr_worker *) worker;
+	atomic_flag busy;
+} chunkmgr_tasks[CHUNKMGR_TASKS];
+
+struct chunkmgr_farthest {
+	const struct chunkmgr *mgr;
+	long     distance;
+	map3_key key;
+	struct chunk *chunk;
+};
+
 void chunkmgr_create(struct chunkmgr *mgr, const struct region *region)
 {
 	mgr->region = region;
-	map3_create(&mgr->chunk_map);
-	pool_create(&mgr->chunk_pool, sizeof(struct chunk));
+	map3_sharded_create(&mgr->chunk_map);
+	map3_create(&mgr->pending_map);
+	pool_create_paged(&mgr->chunk_pool, sizeof(struct chunk),
+	                  CHUNKMGR_POOL_PAGE_LEN);
+	mgr->requests = NULL;
+	for (size_t i = 0; i < CHUNKMGR_WORKERS; ++ i) {
+		mgr->workers[i].mgr = mgr;
+		mgr->workers[i].running = 0;
+	}
+	atomic_init(&mgr->completed, NULL);
+	mgr->publishing = NULL;
+	chunkmgr_set_budget(mgr, CHUNKMGR_DEFAULT_BUDGET);
+	chunkmgr_set_focus(mgr, 0, 0, 0);
+	atomic_init(&mgr->evictions, 0);
+	atomic_init(&mgr->evictions_acked, 0);
+	mgr->retired = NULL;
 }
 
 void chunkmgr_destroy(struct chunkmgr *mgr)
 {
-	map3_destroy(&mgr->chunk_map);
+	/* Cancel workers which never started, their chunks go with the pool */
+	chunkmgr_clear_requests(mgr);
+	for (size_t i = 0; i < CHUNKMGR_WORKERS; ++ i) {
+		struct chunkmgr_worker *w = &mgr->workers[i];
+		struct chunkmgr_worker *expected = w;
+		if (w->running &&
+		    atomic_compare_exchange_strong(&w->task->worker, &expected, NULL))
+			w->running = 0;
+	}
+
+	/* Spinlock waiting for running workers to complete */
+	for (size_t i = 0; i < CHUNKMGR_WORKERS; ++ i)
+		while (mgr->workers[i].running)
+			chunkmgr_update(mgr, 0);
+
+	vector_free(&mgr->retired);
+	vector_free(&mgr->requests);
+	map3_destroy(&mgr->pending_map);
+	map3_sharded_destroy(&mgr->chunk_map);
 	pool_destroy(&mgr->chunk_pool);
 }
 
 struct chunk *
 chunkmgr_chunk_at(struct chunkmgr *mgr, long cy, long cr, long cq)
 {
-	return map3_get(&mgr->chunk_map, (map3_key) { cy, cr, cq });
+	return map3_sharded_get(&mgr->chunk_map, (map3_key) { cy, cr, cq });
 }
 
 struct chunk *
 chunkmgr_create_at(struct chunkmgr *mgr, long cy, long cr, long cq)
 {
 	struct chunk *c = pool_take(&mgr->chunk_pool);
+	chunkmgr_fill(mgr->region, c, cy, cr, cq);
+	map3_sharded_put(&mgr->chunk_map, (map3_key) { cy, cr, cq }, c);
+	return c;
+}
+
+void
+chunkmgr_request(struct chunkmgr *mgr, long cy, long cr, long cq, float priority)
+{
+	if (chunkmgr_chunk_at(mgr, cy, cr, cq) ||
+	    map3_get(&mgr->pending_map, (map3_key) { cy, cr, cq }))
+		return;
+	/* Any non-NULL value marks a chunk pending */
+	map3_put(&mgr->pending_map, (map3_key) { cy, cr, cq }, mgr);
+	request_push(&mgr->requests, (struct chunkmgr_request) {
+		cy, cr, cq, priority
+	});
+}
+
+void
+chunkmgr_clear_requests(struct chunkmgr *mgr)
+{
+	for (size_t i = 0; i < vector_size(mgr->requests); ++ i) {
+		struct chunkmgr_request *r = &mgr->requests[i];
+		map3_del(&mgr->pending_map, (map3_key) { r->cy, r->cr, r->cq });
+	}
+	vector_clear(&mgr->requests);
+}
 
-	/* Populate chunk from region data */
-	for (long y = 0; y < CHUNK_LEN; ++ y)
-	for (long r = 0; r < CHUNK_LEN; ++ r)
-	for (long q = 0; q < CHUNK_LEN; ++ q) {
-		long yy = y + cy * CHUNK_LEN;
-		long rr = r + cr * CHUNK_LEN;
-		long qq = q + cq * CHUNK_LEN;
-
-		enum block *b = chunk_block_at_ptr(c, y, r, q);
-
-		/* Calculate position in region map */
-		float fq = qq;
-		float fr = rr;
-		float x, z;
-		hex_axial_to_pixel(1, fq, fr, &x, &z);
-
-		/* Limit to region */
-		if (x < 0 || z < 0 || x >= mgr->region->size || z >= mgr->region->size)
-		{
-			*b = BLOCK_AIR;
+void
+chunkmgr_set_budget(struct chunkmgr *mgr, size_t bytes)
+{
+	mgr->chunk_budget = MAX(bytes / sizeof(struct chunk), CHUNKMGR_WORKERS);
+}
+
+void
+chunkmgr_set_focus(struct chunkmgr *mgr, long cy, long cr, long cq)
+{
+	mgr->focus[0] = cy;
+	mgr->focus[1] = cr;
+	mgr->focus[2] = cq;
+}
+
+void
+chunkmgr_ack_evictions(struct chunkmgr *mgr, size_t evictions)
+{
+	atomic_store_explicit(&mgr->evictions_acked, evictions,
+	                      memory_order_release);
+}
+
+void
+chunkmgr_update(struct chunkmgr *mgr, unsigned long long budget_ns)
+{
+	unsigned long long start = now_ns();
+
+	chunkmgr_reclaim(mgr);
+
+	/*
+	 * Take everything completed so far. Workers only ever push, and we
+	 * take the whole stack at once, so there's no ABA to worry about.
+	 */
+	struct chunkmgr_worker *done = atomic_exchange_explicit(&mgr->completed,
+	                                                        NULL,
+	                                                        memory_order_acquire);
+	while (done) {
+		struct chunkmgr_worker *next = done->next;
+		done->next = mgr->publishing;
+		mgr->publishing = done;
+		done = next;
+	}
+
+	/* Publish, then put idle workers back to work, while time remains */
+	while (mgr->publishing) {
+		struct chunkmgr_worker *w = mgr->publishing;
+		mgr->publishing = w->next;
+		chunkmgr_publish(mgr, w);
+		if (now_ns() - start > budget_ns)
+			return;
+	}
+	for (size_t i = 0; i < CHUNKMGR_WORKERS; ++ i) {
+		struct chunkmgr_worker *w = &mgr->workers[i];
+		if (w->running || vector_size(mgr->requests) == 0)
 			continue;
-		}
+		if (!chunkmgr_make_room(mgr, &mgr->requests[0]))
+			return;
+		struct chunkmgr_task *t = chunkmgr_task_take();
+		if (!t)
+			return; /* every slot is still queued */
+		struct chunkmgr_request r = request_pop(mgr->requests);
+		w->chunk = pool_take(&mgr->chunk_pool);
+		w->cy = r.cy;
+		w->cr = r.cr;
+		w->cq = r.cq;
+		w->running = 1;
+		w->task = t;
+		t->task = DL_TASK_INIT(chunkmgr_worker_async);
+		atomic_store_explicit(&t->worker, w, memory_order_release);
+		dlasync(&t->task);
+		if (now_ns() - start > budget_ns)
+			return;
+	}
+}
 
-		*b = region_stone_at(mgr->region, x, z) < yy ? BLOCK_AIR : BLOCK_STONE;
+static void
+chunkmgr_fill(const struct region *region, struct chunk *c,
+              long cy, long cr, long cq)
+{
+	/*
+	 * Populate chunk from region data. Stone height only depends upon the
+	 * column so it's sampled once per column, then each layer is filled
+	 * with blocks at or below that height being stone.
+	 */
+	float height[CHUNK_LEN * CHUNK_LEN];
+	region_sample_columns(region, cr * CHUNK_LEN, cq * CHUNK_LEN,
+	                      CHUNK_LEN, CHUNK_LEN, height);
+	for (long y = 0; y < CHUNK_LEN; ++ y) {
+		float yy = y + cy * CHUNK_LEN;
+		enum block *layer = chunk_block_at_ptr(c, y, 0, 0);
+		for (size_t i = 0; i < CHUNK_LEN * CHUNK_LEN; ++ i)
+			layer[i] = height[i] < yy ? BLOCK_AIR : BLOCK_STONE;
 	}
-	map3_put(&mgr->chunk_map, (map3_key) { cy, cr, cq }, c);
-	return c;
+}
+
+static void
+chunkmgr_worker_async(DL_TASK_ARGS)
+{
+	DL_TASK_ENTRY(struct chunkmgr_task, t, task);
+
+	/* Cancelled by chunkmgr_destroy() if we find no worker */
+	struct chunkmgr_worker *w = atomic_exchange(&t->worker, NULL);
+	if (w) {
+		chunkmgr_fill(w->mgr->region, w->chunk, w->cy, w->cr, w->cq);
+
+		/* We may be dispatched again as soon as we're pushed, touch nothing */
+		struct chunkmgr_worker *head = atomic_load_explicit(&w->mgr->completed,
+		                                                    memory_order_relaxed);
+		do {
+			w->next = head;
+		} while (!atomic_compare_exchange_weak_explicit(&w->mgr->completed,
+		                                                &head, w,
+		                                                memory_order_release,
+		                                                memory_order_relaxed));
+	}
+	atomic_flag_clear_explicit(&t->busy, memory_order_release);
+}
+
+/* Returns a free worker task slot, or NULL if all are queued or running */
+static struct chunkmgr_task *
+chunkmgr_task_take(void)
+{
+	for (size_t i = 0; i < CHUNKMGR_TASKS; ++ i) {
+		struct chunkmgr_task *t = &chunkmgr_tasks[i];
+		if (!atomic_flag_test_and_set_explicit(&t->busy, memory_order_acquire))
+			return t;
+	}
+	return NULL;
+}
+
+static void
+chunkmgr_publish(struct chunkmgr *mgr, struct chunkmgr_worker *w)
+{
+	map3_key key = { w->cy, w->cr, w->cq };
+	map3_del(&mgr->pending_map, key);
+	map3_sharded_put(&mgr->chunk_map, key, w->chunk);
+	w->chunk = NULL;
+	w->running = 0;
+}
+
+/*
+ * Evicts chunks until there's room within our budget to generate r, returning
+ * zero if that would mean evicting a chunk at least as near as r.
+ */
+static int
+chunkmgr_make_room(struct chunkmgr *mgr, const struct chunkmgr_request *r)
+{
+	const long distance = chunkmgr_distance(mgr, r->cy, r->cr, r->cq);
+	for (;;) {
+		size_t held = map3_sharded_count(&mgr->chunk_map);
+		for (size_t i = 0; i < CHUNKMGR_WORKERS; ++ i)
+			held += mgr->workers[i].running;
+		if (held < mgr->chunk_budget)
+			return 1;
+
+		/* Entries can't be deleted while iterating, so find then evict */
+		struct chunkmgr_farthest f = { .mgr = mgr, .distance = -1 };
+		map3_sharded_foreach(&mgr->chunk_map, chunkmgr_find_farthest, &f);
+		if (f.distance <= distance)
+			return 0;
+		map3_sharded_del(&mgr->chunk_map, f.key);
+		size_t eviction = atomic_load_explicit(&mgr->evictions,
+		                                       memory_order_relaxed) + 1;
+		vector_push(&mgr->retired, (struct chunkmgr_retired) {
+			f.chunk, eviction
+		});
+		atomic_store_explicit(&mgr->evictions, eviction,
+		                      memory_order_release);
+	}
+}
+
+/* Returns retired chunks whose eviction the reader acknowledged to the pool */
+static void
+chunkmgr_reclaim(struct chunkmgr *mgr)
+{
+	size_t acked = atomic_load_explicit(&mgr->evictions_acked,
+	                                    memory_order_acquire);
+	size_t n = vector_size(mgr->retired);
+	size_t reclaimed = 0;
+	while (reclaimed < n && mgr->retired[reclaimed].eviction <= acked)
+		pool_give(&mgr->chunk_pool, mgr->retired[reclaimed ++].chunk);
+	for (size_t i = reclaimed; i < n; ++ i)
+		mgr->retired[i - reclaimed] = mgr->retired[i];
+	while (reclaimed --)
+		vector_pop(&mgr->retired);
+}
+
+static void
+chunkmgr_find_farthest(void *arg, const struct map3_entry *e)
+{
+	struct chunkmgr_farthest *f = arg;
+	long d = chunkmgr_distance(f->mgr, e->key[0], e->key[1], e->key[2]);
+	if (d > f->distance) {
+		f->distance = d;
+		f->key[0] = e->key[0];
+		f->key[1] = e->key[1];
+		f->key[2] = e->key[2];
+		f->chunk = e->data;
+	}
+}
+
+/* Hexagonal distance in chunks from focus, plus layers */
+static long
+chunkmgr_distance(const struct chunkmgr *mgr, long cy, long cr, long cq)
+{
+	long dy = cy - mgr->focus[0];
+	long dr = cr - mgr->focus[1];
+	long dq = cq - mgr->focus[2];
+	return (labs(dr) + labs(dq) + labs(dr + dq)) / 2 + labs(dy);
+}
+
+/* Binary min heap of requests by priority, stored in a vector */
+static void
+request_push(struct chunkmgr_request **heap, struct chunkmgr_request r)
+{
+	vector_push(heap, r);
+	struct chunkmgr_request *h = *heap;
+	size_t i = vector_size(h) - 1;
+	while (i > 0 && h[(i - 1) / 2].priority > r.priority) {
+		h[i] = h[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	h[i] = r;
+}
+
+static struct chunkmgr_request
+request_pop(struct chunkmgr_request *h)
+{
+	struct chunkmgr_request top = h[0];
+	struct chunkmgr_request last = *vector_tail(h);
+	vector_pop(&h);
+	size_t n = vector_size(h);
+	size_t i = 0;
+	for (;;) {
+		size_t c = 2 * i + 1;
+		if (c >= n)
+			break;
+		if (c + 1 < n && h[c + 1].priority < h[c].priority)
+			++ c;
+		if (h[c].priority >= last.priority)
+			break;
+		h[i] = h[c];
+		i = c;
+	}
+	if (n)
+		h[i] = last;
+	return top;
 }
 
 /*
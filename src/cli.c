@@ -21,7 +21,12 @@ print_help(void)
 	       "Options:\n"
 	       "  -h, --help     Print help and exit\n"
 	       "      --tc       Specify the number of threads to spawn (default: numer of system threads)\n"
-	       "  -v, --version  Print version and exit\n");
+	       "  -v, --version  Print version and exit\n"
+	       "Headless generation:\n"
+	       "      --headless Generate a planet without opening a window and exit\n"
+	       "      --seed     World seed (required with --headless)\n"
+	       "      --scale    World scale [1,5] (default: 3)\n"
+	       "      --out      Directory results are written to (default: .)\n");
 }
 
 /*
@@ -59,7 +64,12 @@ int
 parse_args(struct rtargs *args, int argc, char **argv)
 {
 	/* Default values */
-	args->tc   = system_threads();
+	args->tc       = system_threads();
+	args->headless = 0;
+	args->seed     = 0;
+	args->seed_set = 0;
+	args->scale    = 3;
+	args->out      = ".";
 
 	for (int i = 1; i < argc; ++ i) {
 		if (!argv[i])
@@ -92,6 +102,64 @@ parse_args(struct rtargs *args, int argc, char **argv)
 			++ i; /* Skip processing tc value */
 		}
 
+		/* --headless */
+		else if (strcmp(opt, "--headless") == 0) {
+			args->headless = 1;
+		}
+
+		/* --seed */
+		else if (strcmp(opt, "--seed") == 0) {
+			if (i == argc-1 || !argv[i+1]) {
+				errno = EINVAL;
+				xperror("--seed option not followed by value");
+				return errno;
+			}
+			/* strtoull accepts a minus sign and negates the result */
+			char *endptr;
+			errno = 0;
+			args->seed = strtoull(argv[i+1], &endptr, 10);
+			if (errno || endptr == argv[i+1] || *endptr != '\0' ||
+			    strchr(argv[i+1], '-'))
+			{
+				errno = EINVAL;
+				xperror("Invalid --seed value cannot be converted to unsigned long long by strtoull");
+				return errno;
+			}
+			args->seed_set = 1;
+			++ i; /* Skip processing seed value */
+		}
+
+		/* --scale */
+		else if (strcmp(opt, "--scale") == 0) {
+			if (i == argc-1 || !argv[i+1]) {
+				errno = EINVAL;
+				xperror("--scale option not followed by value");
+				return errno;
+			}
+			char *endptr;
+			errno = 0;
+			args->scale = strtoul(argv[i+1], &endptr, 10);
+			if (errno || endptr == argv[i+1] || *endptr != '\0' ||
+			    args->scale < 1 || args->scale > 5)
+			{
+				errno = EINVAL;
+				xperror("Invalid --scale value must be between 1 and 5");
+				return errno;
+			}
+			++ i; /* Skip processing scale value */
+		}
+
+		/* --out */
+		else if (strcmp(opt, "--out") == 0) {
+			if (i == argc-1 || !argv[i+1]) {
+				errno = EINVAL;
+				xperror("--out option not followed by value");
+				return errno;
+			}
+			args->out = argv[i+1];
+			++ i; /* Skip processing out value */
+		}
+
 		/* -v, --version */
 		else if (strcmp(opt, "-v") == 0 ||
 		         strcmp(opt, "--version") == 0)
@@ -108,5 +176,11 @@ parse_args(struct rtargs *args, int argc, char **argv)
 		}
 	}
 
+	if (args->headless && !args->seed_set) {
+		errno = EINVAL;
+		xperror("--headless requires a --seed");
+		return errno;
+	}
+
 	return 0;
 }
@@ -0,0 +1,211 @@
+#include "hammer/headless.h"
+#include "hammer/error.h"
+#include "hammer/math.h"
+#include "hammer/mem.h"
+#include "hammer/time.h"
+#include "hammer/worldgen/climate.h"
+#include "hammer/worldgen/region.h"
+#include "hammer/worldgen/stream.h"
+#include "hammer/worldgen/tectonic.h"
+#include "hammer/worldgen/world_opts.h"
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAMMER_LIBPNG_SUPPORT
+#include "hammer/image.h"
+#endif
+
+#ifdef _WIN32
+#include <direct.h> /* _mkdir */
+#else
+#include <sys/stat.h> /* mkdir */
+#endif
+
+#define HEADLESS_PATH_MAX_LEN 4096
+
+static struct {
+	dltask task;
+	struct world_opts opts;
+	const char *out;
+	int *rc;
+} headless;
+
+static void headless_run_async(DL_TASK_ARGS);
+static int  make_out_dir(const char *);
+static int  write_map(const char *name, const float *map, size_t size);
+
+dltask *
+headless_runner(const struct rtargs *args, int *rc)
+{
+	headless.task = DL_TASK_INIT(headless_run_async);
+	world_opts_default(&headless.opts, args->seed, args->scale);
+	headless.out = args->out;
+	headless.rc = rc;
+	*rc = 0;
+	return &headless.task;
+}
+
+static void
+headless_run_async(DL_TASK_ARGS)
+{
+	DL_TASK_ENTRY_VOID;
+
+	const struct world_opts *opts = &headless.opts;
+	unsigned long long start_ns = now_ns();
+	unsigned long long stage_ns;
+
+	int rc = make_out_dir(headless.out);
+	if (rc)
+		goto error_making_out_dir;
+
+	printf("Generating seed %llu, scale %u into %s\n",
+	       opts->seed, opts->scale, headless.out);
+
+	/* Lithosphere */
+	stage_ns = now_ns();
+	struct lithosphere *lithosphere = xcalloc(1, sizeof(*lithosphere));
+	lithosphere_create(lithosphere, opts);
+	size_t lithosphere_steps = opts->tectonic.generations *
+	                           opts->tectonic.generation_steps;
+	while (lithosphere->generation < lithosphere_steps)
+		lithosphere_update(lithosphere, opts);
+	rc = write_map("lithosphere", lithosphere->total_mass, LITHOSPHERE_LEN);
+	if (rc)
+		goto error_writing_lithosphere;
+	printf("Lithosphere: %.3fs\n", (now_ns() - stage_ns) / 1e9);
+
+	/* Climate */
+	stage_ns = now_ns();
+	struct climate *climate = xcalloc(1, sizeof(*climate));
+	climate_create(climate, lithosphere);
+	while (climate->generation < CLIMATE_GENERATIONS)
+		climate_update(climate);
+	if ((rc = write_map("uplift", climate->uplift, CLIMATE_LEN)) ||
+	    (rc = write_map("temperature", climate->inv_temp, CLIMATE_LEN)) ||
+	    (rc = write_map("precipitation", climate->precipitation, CLIMATE_LEN)))
+	{
+		goto error_writing_climate;
+	}
+	printf("Climate: %.3fs\n", (now_ns() - stage_ns) / 1e9);
+
+	/* Stream graph */
+	stage_ns = now_ns();
+	struct stream_graph *stream = xcalloc(1, sizeof(*stream));
+	stream_graph_create(stream, climate, opts->seed,
+	                    world_opts_stream_graph_size(opts));
+	while (stream->generation < STREAM_GRAPH_GENERATIONS)
+		stream_graph_update(stream);
+	printf("Stream graph: %.3fs\n", (now_ns() - stage_ns) / 1e9);
+
+	/* Region */
+	stage_ns = now_ns();
+	struct region *region = xcalloc(1, sizeof(*region));
+	region_create(region, 0, 0, STREAM_REGION_SIZE_MIN, stream);
+	if ((rc = write_map("region_stone", region->stone, region->size)) ||
+	    (rc = write_map("region_water", region->water, region->size)))
+	{
+		goto error_writing_region;
+	}
+	printf("Region: %.3fs\n", (now_ns() - stage_ns) / 1e9);
+
+	printf("Total: %.3fs\n", (now_ns() - start_ns) / 1e9);
+
+error_writing_region:
+	region_destroy(region);
+	free(region);
+	stream_graph_destroy(stream);
+	free(stream);
+error_writing_climate:
+	climate_destroy(climate);
+	free(climate);
+error_writing_lithosphere:
+	lithosphere_destroy(lithosphere);
+	free(lithosphere);
+error_making_out_dir:
+	*headless.rc = rc;
+	dlterminate();
+}
+
+/*
+ * Creates the output directory along with any missing parents. Returns zero
+ * on success or sets and returns errno on error.
+ */
+static int
+make_out_dir(const char *path)
+{
+	char dir[HEADLESS_PATH_MAX_LEN];
+	size_t len = strlen(path);
+	if (len >= HEADLESS_PATH_MAX_LEN) {
+		errno = ENAMETOOLONG;
+		xperrorva("Error creating output directory: \"%s\"", path);
+		return errno;
+	}
+	memcpy(dir, path, len + 1);
+
+	/* Create each parent in turn, then the directory itself */
+	for (size_t i = 1; i <= len; ++ i) {
+		char c = dir[i];
+#ifdef _WIN32
+		if ((c != '/' && c != '\\' && c != '\0') || dir[i-1] == ':')
+			continue;
+#else
+		if (c != '/' && c != '\0')
+			continue;
+#endif
+		dir[i] = '\0';
+#ifdef _WIN32
+		int rc = _mkdir(dir);
+#else
+		int rc = mkdir(dir, 0755);
+#endif
+		if (rc != 0 && errno != EEXIST) {
+			xperrorva("Error creating output directory: \"%s\"", dir);
+			return errno;
+		}
+		dir[i] = c;
+	}
+	return 0;
+}
+
+/*
+ * Writes a square map to the output directory, normalized between its
+ * extents as a 16-bit PNG when libpng is available. Otherwise the raw native
+ * float values are dumped. Returns zero on success or sets and returns errno
+ * on error.
+ */
+static int
+write_map(const char *name, const float *map, size_t size)
+{
+	char filename[HEADLESS_PATH_MAX_LEN];
+#ifdef HAMMER_LIBPNG_SUPPORT
+	float min = FLT_MAX;
+	float max = -FLT_MAX;
+	for (size_t i = 0; i < size * size; ++ i) {
+		min = MIN(min, map[i]);
+		max = MAX(max, map[i]);
+	}
+	if (max <= min)
+		max = min + 1;
+	snprintf(filename, HEADLESS_PATH_MAX_LEN, "%s/%s.png", headless.out, name);
+	return write_heightmap(filename, map, size, size, min, max);
+#else
+	snprintf(filename, HEADLESS_PATH_MAX_LEN, "%s/%s.f32", headless.out, name);
+	FILE *f = fopen(filename, "wb");
+	if (!f) {
+		xperrorva("Error creating map file: \"%s\"", filename);
+		return errno;
+	}
+	int rc = 0;
+	if (fwrite(map, sizeof(*map), size * size, f) != size * size) {
+		xperrorva("Error writing map file: \"%s\"", filename);
+		rc = errno ? errno : EIO;
+	}
+	if (fclose(f) != 0) {
+		xperror("Error closing map file");
+		rc = rc ? rc : errno;
+	}
+	return rc;
+#endif
+}
@@ -2,6 +2,7 @@
 #include "hammer/error.h"
 #include "hammer/appstate.h"
 #include "hammer/glthread.h"
+#include "hammer/headless.h"
 #include <deadlock/dl.h>
 #include <float.h>
 #include <stdio.h>
@@ -20,6 +21,16 @@ main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
+	/* Headless generation never creates a window or render thread */
+	if (rtargs.headless) {
+		int rc;
+		if (dlmainex(headless_runner(&rtargs, &rc), NULL, NULL, rtargs.tc)) {
+			xperror("Error creating deadlock scheduler");
+			return EXIT_FAILURE;
+		}
+		return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
 	glthread_create();
 
 	if (dlmainex(appstate_runner(), NULL, NULL, rtargs.tc))
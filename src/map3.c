@@ -4,91 +4,124 @@
 #define MAP3_RESIZE_RATIO 0.9f
 #define MAP3_INIT_SIZE 128
 
+/* Probe distances are stored in a byte, growing the map if one would overflow */
+#define MAP3_MAX_PROBE 254
+
+#define MAP3_META(DIST,TAG) ((uint16_t)(((DIST) + 1) << 8 | (TAG)))
+#define MAP3_META_DIST(META) (((META) >> 8) - 1)
+
 static uint64_t map3_hash(map3_key key);
-static int      map3_eq(const struct map3_entry *, uint64_t, map3_key);
+static int      map3_eq(const struct map3_entry *, map3_key);
+static void     map3_alloc(struct map3 *, size_t size);
 static void     map3_resize(struct map3 *);
-static void     map3_put_impl(struct map3 *, struct map3_entry);
+static int      map3_put_impl(struct map3 *, uint64_t, struct map3_entry);
+static void     map3_backshift(struct map3 *, size_t index);
+static void     map3_del_hashed(struct map3 *, uint64_t, map3_key);
+static void    *map3_get_hashed(struct map3 *, uint64_t, map3_key);
+static void     map3_put_hashed(struct map3 *, uint64_t, map3_key, void *);
+static struct map3_shard *map3_shard_lock(struct map3_sharded *, uint64_t);
+static void     map3_shard_acquire(struct map3_shard *);
+static void     map3_shard_unlock(struct map3_shard *);
 
+/*
+ * Folds the key into 64 bits and finishes with the SplitMix64 mixer so both
+ * the low bits we index by and the high bits we tag and shard by depend upon
+ * every coordinate. With a weaker finish, looking up neighboring keys one
+ * after another, as chunks are requested, ran several times slower.
+ */
 static uint64_t
 map3_hash(map3_key key)
 {
-	/* For better or worse I'm using a 64-bit Fowler-Noll-Vo hash */
-	const uint64_t prime = 1099511628211u;
-	uint64_t hash  = 14695981039346656037u;
-	const char *x_ = (const char *)&key[0];
-	const char *y_ = (const char *)&key[1];
-	const char *z_ = (const char *)&key[2];
-	for (size_t i = 0; i < sizeof(int); ++ i) {
-		hash ^= *x_ ++;
-		hash *= prime;
-		hash ^= *y_ ++;
-		hash *= prime;
-		hash ^= *z_ ++;
-		hash *= prime;
-	}
-	return hash & MAP3_NIL_HASH;
+	uint64_t h = (uint32_t)key[0] * 0x9E3779B97F4A7C15ull +
+	             ((uint64_t)(uint32_t)key[1] << 32 | (uint32_t)key[2]);
+	h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+	h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+	return h ^ (h >> 31);
 }
 
 static int
-map3_eq(const struct map3_entry *e, uint64_t hash, map3_key key)
+map3_eq(const struct map3_entry *e, map3_key key)
 {
-	return e->hash == hash &&
-	       e->key[0] == key[0] &&
+	return e->key[0] == key[0] &&
 	       e->key[1] == key[1] &&
 	       e->key[2] == key[2];
 }
 
+static void
+map3_alloc(struct map3 *m, size_t size)
+{
+	m->entries = xmalloc(size * sizeof(*m->entries));
+	m->meta = xcalloc(size, sizeof(*m->meta));
+	m->entries_size = size;
+}
+
 static void
 map3_resize(struct map3 *m)
 {
 	size_t oldsize = m->entries_size;
 	struct map3_entry *oldentries = m->entries;
+	uint16_t *oldmeta = m->meta;
 
-	m->entries_size *= 2;
-	m->entries = xcalloc(m->entries_size, sizeof(*m->entries));
-	for (size_t i = 0; i < m->entries_size; ++ i) {
-		m->entries[i].hash = MAP3_NIL_HASH;
-		m->entries[i].probe_length = 0;
-	}
-
-	/* No need to rehash since we store unbounded hashes */
+	map3_alloc(m, 2 * oldsize);
 	for (size_t i = 0; i < oldsize; ++ i) {
-		if (map3_isvalid(&oldentries[i]))
-			map3_put_impl(m, oldentries[i]);
+		if (oldmeta[i])
+			map3_put_impl(m, map3_hash(oldentries[i].key), oldentries[i]);
 	}
 
+	free(oldmeta);
 	free(oldentries);
 }
 
-static void
-map3_put_impl(struct map3 *m, struct map3_entry e)
+/* Returns whether e was added, rather than replacing an equal key */
+static int
+map3_put_impl(struct map3 *m, uint64_t hash, struct map3_entry e)
 {
+	/*
+	 * Until we displace another entry we're placing e, which may replace
+	 * an equal key. Anything we displace is already unique.
+	 */
+	int original = 1;
 manual_tailcall: ;
 	const size_t size_mask = m->entries_size - 1;
-	const size_t index = e.hash & size_mask;
-	size_t probe_length = 0;
-	struct map3_entry *candidate = &m->entries[index];
+	size_t index = hash & size_mask;
+	uint16_t meta = MAP3_META(0, hash >> 56);
 
-	/*
-	 * Note the ugly equality check we have to perform here and below,
-	 * lest we turn this into a multi-map. TODO: Not a bad idea.
-	 */
-	while (candidate->probe_length > probe_length ||
-	       ( candidate->probe_length == probe_length &&
-	         !map3_eq(candidate, e.hash, e.key) ))
-	{
-		++ probe_length;
-		candidate = &m->entries[(index + probe_length) & size_mask];
-	}
-	e.probe_length = probe_length;
-
-	struct map3_entry richer = m->entries[(index + probe_length) & size_mask];
-	m->entries[(index + probe_length) & size_mask] = e;
-	if (richer.hash != MAP3_NIL_HASH &&
-	    !map3_eq(&richer, e.hash, e.key))
-	{
-		e = richer;
-		goto manual_tailcall;
+	for (;;) {
+		uint16_t candidate = m->meta[index];
+		if (candidate == 0) {
+			m->meta[index] = meta;
+			m->entries[index] = e;
+			return 1;
+		}
+
+		/*
+		 * Note the ugly equality check we have to perform here, lest we
+		 * turn this into a multi-map. TODO: Not a bad idea.
+		 */
+		if (original && candidate == meta &&
+		    map3_eq(&m->entries[index], e.key))
+		{
+			m->entries[index].data = e.data;
+			return 0;
+		}
+
+		/* Take from the rich, carry on placing whoever we displaced */
+		if ((candidate >> 8) < (meta >> 8)) {
+			struct map3_entry richer = m->entries[index];
+			m->meta[index] = meta;
+			m->entries[index] = e;
+			meta = candidate;
+			e = richer;
+			original = 0;
+		}
+
+		if (MAP3_META_DIST(meta) == MAP3_MAX_PROBE) {
+			map3_resize(m);
+			hash = map3_hash(e.key);
+			goto manual_tailcall;
+		}
+		meta += 1 << 8;
+		index = (index + 1) & size_mask;
 	}
 }
 
@@ -98,11 +131,14 @@ map3_backshift(struct map3 *m, size_t index)
 	const size_t size_mask = m->entries_size - 1;
 	for (;;) {
 		const size_t next = (index + 1) & size_mask;
-		struct map3_entry *e = &m->entries[next];
-		if (e->probe_length == 0)
+		const uint16_t meta = m->meta[next];
+		/* Stop at an empty slot or an entry in its ideal slot */
+		if ((meta >> 8) <= 1) {
+			m->meta[index] = 0;
 			return;
-		m->entries[index] = *e;
-		e->hash = MAP3_NIL_HASH;
+		}
+		m->meta[index] = meta - (1 << 8);
+		m->entries[index] = m->entries[next];
 		index = next;
 	}
 }
@@ -110,69 +146,180 @@ map3_backshift(struct map3 *m, size_t index)
 void
 map3_create(struct map3 *m)
 {
-	m->entries = xcalloc(MAP3_INIT_SIZE, sizeof(*m->entries));
-	m->entries_size = MAP3_INIT_SIZE;
+	map3_alloc(m, MAP3_INIT_SIZE);
 	m->entry_count = 0;
-	for (size_t i = 0; i < MAP3_INIT_SIZE; ++ i) {
-		m->entries[i].hash = MAP3_NIL_HASH;
-		m->entries[i].probe_length = 0;
-	}
 }
 
 void
 map3_destroy(struct map3 *m)
 {
+	free(m->meta);
 	free(m->entries);
 }
 
 void
 map3_del(struct map3 *m, map3_key key)
 {
-	const size_t size_mask = m->entries_size - 1;
+	map3_del_hashed(m, map3_hash(key), key);
+}
+
+void *
+map3_get(struct map3 *m, map3_key key)
+{
+	return map3_get_hashed(m, map3_hash(key), key);
+}
+
+void
+map3_put(struct map3 *m, map3_key key, void *d)
+{
+	map3_put_hashed(m, map3_hash(key), key, d);
+}
+
+void
+map3_sharded_create(struct map3_sharded *m)
+{
+	for (size_t i = 0; i < MAP3_SHARDS; ++ i) {
+		map3_create(&m->shards[i].map);
+		atomic_flag_clear(&m->shards[i].lock);
+		atomic_init(&m->shards[i].count, 0);
+	}
+}
+
+void
+map3_sharded_destroy(struct map3_sharded *m)
+{
+	for (size_t i = 0; i < MAP3_SHARDS; ++ i)
+		map3_destroy(&m->shards[i].map);
+}
+
+void
+map3_sharded_del(struct map3_sharded *m, map3_key key)
+{
+	const uint64_t hash = map3_hash(key);
+	struct map3_shard *s = map3_shard_lock(m, hash);
+	map3_del_hashed(&s->map, hash, key);
+	map3_shard_unlock(s);
+}
+
+void *
+map3_sharded_get(struct map3_sharded *m, map3_key key)
+{
 	const uint64_t hash = map3_hash(key);
-	const size_t index = hash & size_mask;
-	size_t probe_length = 0;
-	struct map3_entry *e = &m->entries[index];
+	struct map3_shard *s = map3_shard_lock(m, hash);
+	void *d = map3_get_hashed(&s->map, hash, key);
+	map3_shard_unlock(s);
+	return d;
+}
+
+void
+map3_sharded_put(struct map3_sharded *m, map3_key key, void *d)
+{
+	const uint64_t hash = map3_hash(key);
+	struct map3_shard *s = map3_shard_lock(m, hash);
+	map3_put_hashed(&s->map, hash, key, d);
+	map3_shard_unlock(s);
+}
+
+size_t
+map3_sharded_count(struct map3_sharded *m)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < MAP3_SHARDS; ++ i)
+		count += atomic_load_explicit(&m->shards[i].count,
+		                              memory_order_relaxed);
+	return count;
+}
+
+void
+map3_sharded_foreach(struct map3_sharded *m, map3_fn fn, void *arg)
+{
+	for (size_t i = 0; i < MAP3_SHARDS; ++ i) {
+		struct map3_shard *s = &m->shards[i];
+		map3_shard_acquire(s);
+		for (size_t j = 0; j < s->map.entries_size; ++ j) {
+			if (map3_isvalid(&s->map, j))
+				fn(arg, &s->map.entries[j]);
+		}
+		map3_shard_unlock(s);
+	}
+}
+
+static void
+map3_del_hashed(struct map3 *m, uint64_t hash, map3_key key)
+{
+	const size_t size_mask = m->entries_size - 1;
+	size_t index = hash & size_mask;
+	unsigned meta = MAP3_META(0, hash >> 56);
 	/* Silently ignore attempts to delete non-existant */
-	do {
-		if (map3_eq(e, hash, key)) {
+	for (;;) {
+		unsigned candidate = m->meta[index];
+		if (candidate == meta && map3_eq(&m->entries[index], key)) {
 			-- m->entry_count;
-			e->hash = MAP3_NIL_HASH;
-			map3_backshift(m, (index + probe_length) & size_mask);
+			map3_backshift(m, index);
 			return;
 		}
-		++ probe_length;
-		e = &m->entries[(index + probe_length) & size_mask];
-	} while (e->probe_length > 0);
+		if ((candidate >> 8) < (meta >> 8))
+			return;
+		meta += 1 << 8;
+		index = (index + 1) & size_mask;
+	}
 }
 
-void *
-map3_get(struct map3 *m, map3_key key)
+/*
+ * Robin Hood ordering means we can stop as soon as we meet an entry closer
+ * to its ideal slot than we are to ours, which includes empty slots.
+ */
+static void *
+map3_get_hashed(struct map3 *m, uint64_t hash, map3_key key)
 {
 	const size_t size_mask = m->entries_size - 1;
-	const uint64_t hash = map3_hash(key);
-	const size_t index = hash & size_mask;
-	size_t probe_length = 0;
-	struct map3_entry *e = &m->entries[index];
-	do {
-		if (map3_eq(e, hash, key))
-			return e->data;
-		++ probe_length;
-		e = &m->entries[(index + probe_length) & size_mask];
-	} while (probe_length <= e->probe_length);
-
-	return NULL;
+	size_t index = hash & size_mask;
+	unsigned meta = MAP3_META(0, hash >> 56);
+	for (;;) {
+		unsigned candidate = m->meta[index];
+		if (candidate == meta && map3_eq(&m->entries[index], key))
+			return m->entries[index].data;
+		if ((candidate >> 8) < (meta >> 8))
+			return NULL;
+		meta += 1 << 8;
+		index = (index + 1) & size_mask;
+	}
 }
 
-void
-map3_put(struct map3 *m, map3_key key, void *d)
+static void
+map3_put_hashed(struct map3 *m, uint64_t hash, map3_key key, void *d)
 {
-	if (++ m->entry_count > MAP3_RESIZE_RATIO * m->entries_size)
+	if (m->entry_count + 1 > MAP3_RESIZE_RATIO * m->entries_size)
 		map3_resize(m);
 
-	map3_put_impl(m, (struct map3_entry) {
+	m->entry_count += map3_put_impl(m, hash, (struct map3_entry) {
 		.data = d,
-		.hash = map3_hash(key),
 		.key = { key[0], key[1], key[2] }
 	});
 }
+
+/*
+ * Shards are chosen by high bits of the hash, while each shard's map indexes
+ * by the low bits. Critical sections are a single probe so a spin lock does
+ * just fine.
+ */
+static struct map3_shard *
+map3_shard_lock(struct map3_sharded *m, uint64_t hash)
+{
+	struct map3_shard *s = &m->shards[(hash >> 32) & (MAP3_SHARDS - 1)];
+	map3_shard_acquire(s);
+	return s;
+}
+
+static void
+map3_shard_acquire(struct map3_shard *s)
+{
+	while (atomic_flag_test_and_set_explicit(&s->lock, memory_order_acquire)) ;
+}
+
+static void
+map3_shard_unlock(struct map3_shard *s)
+{
+	atomic_store_explicit(&s->count, s->map.entry_count, memory_order_relaxed);
+	atomic_flag_clear_explicit(&s->lock, memory_order_release);
+}
@@ -0,0 +1,115 @@
+#include "hammer/noise_field.h"
+#include "hammer/math.h"
+#include "hammer/mem.h"
+#include "hammer/parallel.h"
+#include <stdlib.h>
+
+/* Rows per band while evaluating a noise field */
+#define NOISE_FIELD_BAND_ROWS 8
+
+struct noise_field_job {
+	const struct noise_field *f;
+	const struct noise_fbm   *fbm;
+	noise_field_fn            fn;
+	void                     *arg;
+};
+
+static void noise_field_band(void *, size_t y0, size_t y1);
+
+void
+noise_field_create(struct noise_field *f, unsigned long w, unsigned long h,
+                   float frq)
+{
+	f->w = w;
+	f->h = h;
+	f->cx = xmalloc(w * sizeof(*f->cx));
+	f->cz = xmalloc(w * sizeof(*f->cz));
+	f->ry = xmalloc(h * sizeof(*f->ry));
+	f->rw = xmalloc(h * sizeof(*f->rw));
+	for (unsigned long x = 0; x < w; ++ x) {
+		float u = (float)x / w;
+		f->cx[x] = cosf(u*2*M_PI)*frq/(2*M_PI);
+		f->cz[x] = sinf(u*2*M_PI)*frq/(2*M_PI);
+	}
+	for (unsigned long y = 0; y < h; ++ y) {
+		float v = (float)y / h;
+		f->ry[y] = sinf(v*2*M_PI)*frq/(2*M_PI);
+		f->rw[y] = cosf(v*2*M_PI)*frq/(2*M_PI);
+	}
+}
+
+void
+noise_field_destroy(struct noise_field *f)
+{
+	free(f->cx);
+	free(f->cz);
+	free(f->ry);
+	free(f->rw);
+}
+
+void
+noise_field_rows(const struct noise_field *f, const struct noise_fbm *fbm,
+                 noise_field_fn fn, void *arg)
+{
+	struct noise_field_job job = { f, fbm, fn, arg };
+	parallel_for(f->h, NOISE_FIELD_BAND_ROWS, noise_field_band, &job);
+}
+
+static void
+noise_field_band(void *arg, size_t y0, size_t y1)
+{
+	const struct noise_field_job *job = arg;
+	const struct noise_fbm *fbm = job->fbm;
+	const size_t w = job->f->w;
+
+	/* Noise is evaluated a row at a time, see opensimplex4_fbm_batch */
+	float *buf = xmalloc((9 + fbm->count) * w * sizeof(*buf));
+	float *axis[4]   = { buf,         buf +     w, buf + 2 * w, buf + 3 * w };
+	float *scaled[4] = { buf + 4 * w, buf + 5 * w, buf + 6 * w, buf + 7 * w };
+	float *disp = buf + 8 * w;
+	float **rows = xmalloc(fbm->count * sizeof(*rows));
+	for (size_t k = 0; k < fbm->count; ++ k)
+		rows[k] = buf + (9 + k) * w;
+
+	for (size_t y = y0; y < y1; ++ y) {
+		for (size_t x = 0; x < w; ++ x) {
+			axis[0][x] = job->f->cx[x];
+			axis[1][x] = job->f->ry[y];
+			axis[2][x] = job->f->cz[x];
+			axis[3][x] = job->f->rw[y];
+		}
+
+		if (fbm->warp) {
+			for (size_t a = 0; a < 4; ++ a)
+			for (size_t x = 0; x < w; ++ x)
+				scaled[a][x] = axis[a][x]*fbm->warp_scale;
+			for (size_t a = 0; a < 4; ++ a) {
+				opensimplex4_fbm_batch(fbm->warp[a],
+				                       scaled[0], scaled[1],
+				                       scaled[2], scaled[3],
+				                       disp, w,
+				                       fbm->warp_oct, fbm->warp_per);
+				for (size_t x = 0; x < w; ++ x) {
+					axis[a][x] += disp[x];
+					if (fbm->warp_cascade)
+						scaled[a][x] = axis[a][x]*fbm->warp_scale;
+				}
+			}
+		}
+
+		for (size_t a = 0; a < 4; ++ a)
+		for (size_t x = 0; x < w; ++ x)
+			scaled[a][x] = axis[a][x]*fbm->scale;
+		for (size_t k = 0; k < fbm->count; ++ k) {
+			opensimplex4_fbm_batch(fbm->n[k],
+			                       scaled[0], scaled[1],
+			                       scaled[2], scaled[3],
+			                       rows[k], w, fbm->oct, fbm->per);
+		}
+
+		job->fn(job->arg, y, rows);
+	}
+
+	free(rows);
+	free(buf);
+}
@@ -1,4 +1,5 @@
 #include "hammer/opensimplex.h"
+#include "hammer/math.h"
 #include "hammer/mem.h"
 #include <stdbool.h>
 #include <stdint.h>
@@ -37,6 +38,22 @@
 #define NORM_CONSTANT_3D 103
 #define NORM_CONSTANT_4D 30
 
+/* Vectorized batch kernels, chosen at runtime, see sweep */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OPENSIMPLEX_SIMD 1
+#else
+#define OPENSIMPLEX_SIMD 0
+#endif
+#if defined(__GNUC__)
+#define SWEEP_INLINE inline __attribute__((always_inline))
+#else
+#define SWEEP_INLINE inline
+#endif
+#if defined(__clang__)
+/* Fused multiply-adds would round differently on each instruction set */
+#pragma STDC FP_CONTRACT OFF
+#endif
+
 /*
  * Gradients for 2D. They approximate the directions to the vertices of an
  * octagon from the center.
@@ -2196,3 +2213,565 @@ opensimplex4_fbm(const struct opensimplex *osn,
     }
     return acc;
 }
+
+/*
+ * The scalar variants above follow a chain of branches to find which lattice
+ * points surround the input, which doesn't vectorize. The batch variants
+ * instead make the same comparisons on every lane, see select in
+ * opensimplex_sweep.h, then sweep the lattice points any lane picked. Each
+ * point's contribution is computed as in the scalar variants, but for the
+ * order of a few additions, so the two agree to within a few ULP.
+ *
+ * The lattice points in range of anywhere in the super-cell are listed in
+ * lattice2/3/4, with their offset from the super-cell origin. select2/3/4
+ * maps the outcome of the comparisons to the set of those points the scalar
+ * variants visit, a bit set for each in vertices2/3/4. The tables were
+ * generated by forcing the scalar variants down every combination of
+ * branches, and recording which points each visits.
+ */
+#define LATTICE_MAX 72
+
+struct lattice_point {
+    signed char offset[4];
+    float squish; /* offset squished back onto the input grid */
+};
+
+struct lattice {
+    const struct lattice_point *point;
+    const unsigned char *select;
+    const uint64_t (*vertices)[2];
+    float stretch;
+    float squish;
+    float norm;
+};
+
+#define L2(X,Y)     { { X, Y },       (X+Y)     * SQUISH_CONSTANT_2D }
+#define L3(X,Y,Z)   { { X, Y, Z },    (X+Y+Z)   * SQUISH_CONSTANT_3D }
+#define L4(X,Y,Z,W) { { X, Y, Z, W }, (X+Y+Z+W) * SQUISH_CONSTANT_4D }
+
+static const struct lattice_point lattice2[8] = {
+    L2(-1,  1), L2( 0,  0), L2( 0,  1), L2( 0,  2),
+    L2( 1, -1), L2( 1,  0), L2( 1,  1), L2( 2,  0),
+};
+
+static const struct lattice_point lattice3[26] = {
+    L3(-1,  0,  1), L3(-1,  1,  0), L3(-1,  1,  1),
+    L3( 0, -1,  1), L3( 0,  0,  0), L3( 0,  0,  1),
+    L3( 0,  0,  2), L3( 0,  1, -1), L3( 0,  1,  0),
+    L3( 0,  1,  1), L3( 0,  1,  2), L3( 0,  2,  0),
+    L3( 0,  2,  1), L3( 1, -1,  0), L3( 1, -1,  1),
+    L3( 1,  0, -1), L3( 1,  0,  0), L3( 1,  0,  1),
+    L3( 1,  0,  2), L3( 1,  1, -1), L3( 1,  1,  0),
+    L3( 1,  1,  1), L3( 1,  2,  0), L3( 2,  0,  0),
+    L3( 2,  0,  1), L3( 2,  1,  0),
+};
+
+static const struct lattice_point lattice4[72] = {
+    L4(-1,  0,  0,  1), L4(-1,  0,  1,  0), L4(-1,  0,  1,  1),
+    L4(-1,  1,  0,  0), L4(-1,  1,  0,  1), L4(-1,  1,  1,  0),
+    L4(-1,  1,  1,  1), L4( 0, -1,  0,  1), L4( 0, -1,  1,  0),
+    L4( 0, -1,  1,  1), L4( 0,  0, -1,  1), L4( 0,  0,  0,  0),
+    L4( 0,  0,  0,  1), L4( 0,  0,  0,  2), L4( 0,  0,  1, -1),
+    L4( 0,  0,  1,  0), L4( 0,  0,  1,  1), L4( 0,  0,  1,  2),
+    L4( 0,  0,  2,  0), L4( 0,  0,  2,  1), L4( 0,  1, -1,  0),
+    L4( 0,  1, -1,  1), L4( 0,  1,  0, -1), L4( 0,  1,  0,  0),
+    L4( 0,  1,  0,  1), L4( 0,  1,  0,  2), L4( 0,  1,  1, -1),
+    L4( 0,  1,  1,  0), L4( 0,  1,  1,  1), L4( 0,  1,  1,  2),
+    L4( 0,  1,  2,  0), L4( 0,  1,  2,  1), L4( 0,  2,  0,  0),
+    L4( 0,  2,  0,  1), L4( 0,  2,  1,  0), L4( 0,  2,  1,  1),
+    L4( 1, -1,  0,  0), L4( 1, -1,  0,  1), L4( 1, -1,  1,  0),
+    L4( 1, -1,  1,  1), L4( 1,  0, -1,  0), L4( 1,  0, -1,  1),
+    L4( 1,  0,  0, -1), L4( 1,  0,  0,  0), L4( 1,  0,  0,  1),
+    L4( 1,  0,  0,  2), L4( 1,  0,  1, -1), L4( 1,  0,  1,  0),
+    L4( 1,  0,  1,  1), L4( 1,  0,  1,  2), L4( 1,  0,  2,  0),
+    L4( 1,  0,  2,  1), L4( 1,  1, -1,  0), L4( 1,  1, -1,  1),
+    L4( 1,  1,  0, -1), L4( 1,  1,  0,  0), L4( 1,  1,  0,  1),
+    L4( 1,  1,  0,  2), L4( 1,  1,  1, -1), L4( 1,  1,  1,  0),
+    L4( 1,  1,  1,  1), L4( 1,  1,  2,  0), L4( 1,  2,  0,  0),
+    L4( 1,  2,  0,  1), L4( 1,  2,  1,  0), L4( 2,  0,  0,  0),
+    L4( 2,  0,  0,  1), L4( 2,  0,  1,  0), L4( 2,  0,  1,  1),
+    L4( 2,  1,  0,  0), L4( 2,  1,  0,  1), L4( 2,  1,  1,  0),
+};
+
+#undef L2
+#undef L3
+#undef L4
+
+static const unsigned char select2[16] = {
+     1, 1, 0, 0, 2, 3, 0, 0, 1, 1, 0, 0, 4, 5, 0, 0,
+};
+
+static const uint64_t vertices2[6][2] = {
+    { 0x0000000000000000, 0x00 },  { 0x0000000000000066, 0x00 },
+    { 0x0000000000000027, 0x00 },  { 0x000000000000006c, 0x00 },
+    { 0x0000000000000036, 0x00 },  { 0x00000000000000e4, 0x00 },
+};
+
+static const unsigned char select3[1024] = {
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 5, 0, 6, 0, 0, 0, 4, 0, 0, 0, 7, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     9, 0,10, 0,11, 0, 0, 0, 9, 0, 0, 0, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0,12, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0,13, 0, 0, 0,14, 0, 0, 0,13, 0, 0, 0,15, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,16, 0, 0, 0, 6, 0, 0, 0,16, 0, 0, 0,11, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,17, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,18, 0, 0, 0,15, 0, 0, 0,18, 0, 0, 0,19,20, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0,21, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0,22, 0, 0, 0,14, 0, 0, 0,22, 0, 0, 0,19,23, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,24, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0,25, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static const uint64_t vertices3[26][2] = {
+    { 0x0000000000000000, 0x00 },  { 0x00000000009b0320, 0x00 },
+    { 0x0000000000134330, 0x00 },  { 0x0000000000930324, 0x00 },
+    { 0x0000000000190130, 0x00 },  { 0x00000000001b0330, 0x00 },
+    { 0x000000000001a130, 0x00 },  { 0x00000000000101b2, 0x00 },
+    { 0x00000000001b0b20, 0x00 },  { 0x0000000000010334, 0x00 },
+    { 0x0000000000130334, 0x00 },  { 0x0000000000010139, 0x00 },
+    { 0x0000000000130b24, 0x00 },  { 0x0000000000320b00, 0x00 },
+    { 0x0000000000321600, 0x00 },  { 0x0000000002720200, 0x00 },
+    { 0x0000000000034130, 0x00 },  { 0x0000000000934320, 0x00 },
+    { 0x0000000000b30200, 0x00 },  { 0x0000000001360200, 0x00 },
+    { 0x0000000000b30320, 0x00 },  { 0x0000000000134360, 0x00 },
+    { 0x0000000000320260, 0x00 },  { 0x0000000000330360, 0x00 },
+    { 0x0000000000330b20, 0x00 },  { 0x0000000000130364, 0x00 },
+};
+
+static const unsigned char select4[4096] = {
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 1, 0, 0, 9, 0, 0, 0, 8, 0, 0, 0,10, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,11, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    12,13, 0, 0,14, 0, 0, 0,12, 0, 0, 0,10, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0,15, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    16,17, 0, 0,18, 0, 0, 0,16, 0, 0, 0,10, 0, 0, 0, 0, 0, 0, 0, 0,19, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0,20, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,21, 3, 0, 0, 9, 0, 0, 0,21, 0, 0, 0,14, 0, 0, 0,
+     0,13, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,22, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0,23, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    24,25, 0, 0,18, 0, 0, 0,24, 0, 0, 0,14, 0, 0, 0, 0, 0, 0, 0, 0,26, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0,27, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,28, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0,29, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,30,31, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0,32, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,33,34, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,35, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0,36, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,37,38, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,39, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,40,41, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,42, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0,43, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0,15, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,44,45, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0,23, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,46, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0,47, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,48, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,49, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,50,51, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,52, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0,53, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,54, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0,46, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,55, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,56,57, 0, 0, 0,58, 0, 0, 0,57, 0, 0, 0,59,
+     0, 0, 0, 0, 0, 0,60, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,61, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0,62,63, 0, 0, 0,64, 0, 0, 0,63, 0, 0, 0,59, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,65, 5, 0, 0, 9, 0, 0, 0,65, 0, 0, 0,18, 0, 0, 0,
+     0,17, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,66, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    24,25, 0, 0,14, 0, 0, 0,24, 0, 0, 0,18, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0,47, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,67, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0,68, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0,19, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,69,70, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0,26, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,48, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,55, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0,67, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,71, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,72,73, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,74, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0,75, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,76, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0,77, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,78,79, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0,80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,81,82, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,83, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0,84, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,85,86, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,87, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,88,89, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,90, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0,91, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,92, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0,49, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,56,57, 0, 0, 0,59, 0, 0, 0,57, 0, 0, 0,58,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,71, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0,93, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,94, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0,95,96, 0, 0, 0,64, 0, 0, 0,96, 0, 0, 0,58, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,97, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0,52, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,61,98, 0, 0, 0,59, 0, 0, 0,98, 0, 0, 0,99,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,74, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,94,100, 0, 0, 0,58, 0, 0, 0,100, 0, 0, 0,99,
+     0, 0, 0, 0, 0, 0,101, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0,102,103, 0, 0, 0,64, 0, 0, 0,103, 0, 0, 0,99, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,104, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0,53, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,62, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,75, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,95, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0,105, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,102, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static const uint64_t vertices4[106][2] = {
+    { 0x0000000000000000, 0x00 },  { 0x00d0980009819800, 0x00 },
+    { 0x00d0980009819000, 0x02 },  { 0x0080d84009819800, 0x00 },
+    { 0x008098000d819020, 0x02 },  { 0x00809a2009819800, 0x00 },
+    { 0x00809a2009819000, 0x02 },  { 0x0080980009819204, 0x02 },
+    { 0x00d0080000809800, 0x00 },  { 0x00000d1000809800, 0x00 },
+    { 0x0000080000d09808, 0x00 },  { 0x00d0980109819000, 0x00 },
+    { 0x000008000c809820, 0x00 },  { 0x008098000d819820, 0x00 },
+    { 0x000008000080d902, 0x00 },  { 0x008098010d819020, 0x00 },
+    { 0x0000080001a09810, 0x00 },  { 0x0080980009a19810, 0x00 },
+    { 0x0000080000809c81, 0x00 },  { 0x00809a2109819000, 0x00 },
+    { 0x0080980109819204, 0x00 },  { 0x0000c84000809800, 0x00 },
+    { 0x00d0980009859000, 0x00 },  { 0x008098000d859020, 0x00 },
+    { 0x0000080000819a04, 0x00 },  { 0x0080980009819a04, 0x00 },
+    { 0x00809a2009859000, 0x00 },  { 0x0080980009859204, 0x00 },
+    { 0x0080d84009819000, 0x02 },  { 0x0080d84109819000, 0x00 },
+    { 0x0c80980009819000, 0x02 },  { 0x0d81980019010000, 0x02 },
+    { 0x0080d84009859000, 0x00 },  { 0x0c80980009859000, 0x00 },
+    { 0x0d81900019058000, 0x00 },  { 0x0d85900019010000, 0x08 },
+    { 0x0080d8400981b000, 0x00 },  { 0x0081988009819000, 0x02 },
+    { 0x0981988019010000, 0x02 },  { 0x09a5900019010000, 0x08 },
+    { 0x0081988009859000, 0x00 },  { 0x0981908019058000, 0x00 },
+    { 0x0985908019010000, 0x08 },  { 0x0985900019010040, 0x08 },
+    { 0x0c80980109819000, 0x00 },  { 0x0d81900119810000, 0x00 },
+    { 0x0d81900459010000, 0x00 },  { 0x008098000d81b020, 0x00 },
+    { 0x0d81900019013000, 0x00 },  { 0x09a1900459010000, 0x00 },
+    { 0x0080980019859040, 0x00 },  { 0x0981900019058040, 0x00 },
+    { 0x0981908459010000, 0x00 },  { 0x0981900459010040, 0x00 },
+    { 0x4d81900019010000, 0x20 },  { 0x0d81b00019010000, 0x04 },
+    { 0x5981900019010000, 0x20 },  { 0x5981000010000000, 0x20 },
+    { 0x9b01000010000000, 0x40 },  { 0x3901000010000000, 0x81 },
+    { 0x0d819000190b0000, 0x00 },  { 0x1985900019010000, 0x08 },
+    { 0x1981900459010000, 0x00 },  { 0x1901000458000000, 0x00 },
+    { 0x19010008b0000000, 0x00 },  { 0x00001a2000809800, 0x00 },
+    { 0x00d098000981b000, 0x00 },  { 0x00809a200981b000, 0x00 },
+    { 0x008098000981b204, 0x00 },  { 0x01a0980009819000, 0x02 },
+    { 0x09a1980019010000, 0x02 },  { 0x09a1b00019010000, 0x04 },
+    { 0x008198800981b000, 0x00 },  { 0x0981908019013000, 0x00 },
+    { 0x0981b08019010000, 0x04 },  { 0x0981b00019010040, 0x04 },
+    { 0x0080980009a19010, 0x02 },  { 0x0080980109a19010, 0x00 },
+    { 0x01a0980109819000, 0x00 },  { 0x09a1900119810000, 0x00 },
+    { 0x0080980009a59010, 0x00 },  { 0x0080980119819040, 0x00 },
+    { 0x0981900119810040, 0x00 },  { 0x0d8190021b010000, 0x00 },
+    { 0x0080980009a1b010, 0x00 },  { 0x01a098000981b000, 0x00 },
+    { 0x09a1900019013000, 0x00 },  { 0x09a190021b010000, 0x00 },
+    { 0x008098001981b040, 0x00 },  { 0x0981900019013040, 0x00 },
+    { 0x098190821b010000, 0x00 },  { 0x098190021b010040, 0x00 },
+    { 0x49a1900019010000, 0x20 },  { 0x09a19000190b0000, 0x00 },
+    { 0x1981b00019010000, 0x04 },  { 0x198190021b010000, 0x00 },
+    { 0x1901000213000000, 0x00 },  { 0x4981908019010000, 0x20 },
+    { 0x1905800010000000, 0x08 },  { 0x190b000010000000, 0x10 },
+    { 0x1901300010000000, 0x04 },  { 0x09819080190b0000, 0x00 },
+    { 0x19819000190b0000, 0x00 },  { 0x19010000100b0000, 0x00 },
+    { 0x4981900019010040, 0x20 },  { 0x09819000190b0040, 0x00 },
+};
+
+static const struct lattice lattices[5] = {
+    [2] = { lattice2, select2, vertices2,
+            STRETCH_CONSTANT_2D, SQUISH_CONSTANT_2D, NORM_CONSTANT_2D },
+    [3] = { lattice3, select3, vertices3,
+            STRETCH_CONSTANT_3D, SQUISH_CONSTANT_3D, NORM_CONSTANT_3D },
+    [4] = { lattice4, select4, vertices4,
+            STRETCH_CONSTANT_4D, SQUISH_CONSTANT_4D, NORM_CONSTANT_4D },
+};
+
+/*
+ * Looks up the gradient of each lattice point in visit around the super-cell
+ * at base, hashed as in extrapolate2/3/4. Lattice points are sorted, so each
+ * reuses the hash of the axes it shares with the last.
+ */
+static SWEEP_INLINE void
+lattice_gradients(const struct opensimplex *osn, const struct lattice *lat,
+                  int dim, const int *base, const uint64_t *visit,
+                  float (*g)[4])
+{
+    int h[4];
+    const signed char *last = NULL;
+    for (size_t word = 0; word < 2; ++ word)
+    for (uint64_t bits = visit[word]; bits; bits &= bits - 1) {
+        size_t v = word * 64 + ctz64(bits);
+        const signed char *o = lat->point[v].offset;
+        int k = 0;
+        while (last && k < dim - 1 && o[k] == last[k])
+            ++ k;
+        for (; k < dim - 1; ++ k)
+            h[k] = osn->perm[((k ? h[k-1] : 0) + base[k] + o[k]) & 0xFF];
+        last = o;
+
+        int j = (h[dim-2] + base[dim-1] + o[dim-1]) & 0xFF;
+        int i;
+        switch (dim) {
+        case 2:
+            i = osn->perm[j] & 0x0E;
+            g[v][0] = grad2[i];
+            g[v][1] = grad2[i+1];
+            break;
+        case 3:
+            i = osn->perm3[j];
+            g[v][0] = grad3[i];
+            g[v][1] = grad3[i+1];
+            g[v][2] = grad3[i+2];
+            break;
+        default:
+            i = osn->perm[j] & 0xFC;
+            g[v][0] = grad4[i];
+            g[v][1] = grad4[i+1];
+            g[v][2] = grad4[i+2];
+            g[v][3] = grad4[i+3];
+            break;
+        }
+    }
+}
+
+/* Scalar sweep, for when no vector instruction set is available. */
+#define SWEEP_NAME(N)     N##_scalar
+#define SWEEP_ATTR
+#define SWEEP_W           1
+#define V_T               float
+#define VI_T              int
+#define M_T               int
+#define V_SET1(A)         (float)(A)
+#define V_LOAD(P)         (*(P))
+#define V_STORE(P,A)      (*(P) = (A))
+#define V_ADD(A,B)        ((A) + (B))
+#define V_SUB(A,B)        ((A) - (B))
+#define V_MUL(A,B)        ((A) * (B))
+#define V_DIV(A,B)        ((A) / (B))
+#define V_FLOOR(A)        floorf(A)
+#define V_TOINT(A)        (int)(A)
+#define V_GT(A,B)         ((A) > (B))
+#define V_GE(A,B)         ((A) >= (B))
+#define V_LT(A,B)         ((A) < (B))
+#define V_LE(A,B)         ((A) <= (B))
+#define V_AND(M,A)        ((M) ? (A) : 0.0f)
+#define V_BLEND(A,B,M)    ((M) ? (B) : (A))
+#define VI_SET1(A)        (A)
+#define VI_ADD(A,B)       ((A) + (B))
+#define VI_STORE(P,A)     (*(P) = (A))
+#define VI_TOFLOAT(A)     (float)(A)
+#define M_AND(A,B)        ((A) & (B))
+#define M_OR(A,B)         ((A) | (B))
+#define M_ANDNOT(A,B)     ((A) & !(B))
+#define M_BITS(M)         (unsigned)(M)
+#define M_FROM_BITS(B)    (int)((B) & 1)
+#include "opensimplex_sweep.h"
+
+#if OPENSIMPLEX_SIMD
+#include <immintrin.h>
+
+#define SWEEP_NAME(N)     N##_sse41
+#define SWEEP_ATTR        __attribute__((target("sse4.1")))
+#define SWEEP_W           4
+#define V_T               __m128
+#define VI_T              __m128i
+#define M_T               __m128
+#define V_SET1(A)         _mm_set1_ps(A)
+#define V_LOAD(P)         _mm_loadu_ps(P)
+#define V_STORE(P,A)      _mm_storeu_ps(P, A)
+#define V_ADD(A,B)        _mm_add_ps(A, B)
+#define V_SUB(A,B)        _mm_sub_ps(A, B)
+#define V_MUL(A,B)        _mm_mul_ps(A, B)
+#define V_DIV(A,B)        _mm_div_ps(A, B)
+#define V_FLOOR(A)        _mm_floor_ps(A)
+#define V_TOINT(A)        _mm_cvttps_epi32(A)
+#define V_GT(A,B)         _mm_cmpgt_ps(A, B)
+#define V_GE(A,B)         _mm_cmpge_ps(A, B)
+#define V_LT(A,B)         _mm_cmplt_ps(A, B)
+#define V_LE(A,B)         _mm_cmple_ps(A, B)
+#define V_AND(M,A)        _mm_and_ps(M, A)
+#define V_BLEND(A,B,M)    _mm_blendv_ps(A, B, M)
+#define VI_SET1(A)        _mm_set1_epi32(A)
+#define VI_ADD(A,B)       _mm_add_epi32(A, B)
+#define VI_STORE(P,A)     _mm_storeu_si128((__m128i *)(P), A)
+#define VI_TOFLOAT(A)     _mm_cvtepi32_ps(A)
+#define M_AND(A,B)        _mm_and_ps(A, B)
+#define M_OR(A,B)         _mm_or_ps(A, B)
+#define M_ANDNOT(A,B)     _mm_andnot_ps(B, A)
+#define M_BITS(M)         (unsigned)_mm_movemask_ps(M)
+#define M_FROM_BITS(B)    _mm_castsi128_ps(_mm_cmpeq_epi32( \
+                              _mm_and_si128(_mm_set1_epi32(B), _mm_setr_epi32(1, 2, 4, 8)), \
+                              _mm_setr_epi32(1, 2, 4, 8)))
+#include "opensimplex_sweep.h"
+
+#define SWEEP_NAME(N)     N##_avx2
+#define SWEEP_ATTR        __attribute__((target("avx2")))
+#define SWEEP_W           8
+#define V_T               __m256
+#define VI_T              __m256i
+#define M_T               __m256
+#define V_SET1(A)         _mm256_set1_ps(A)
+#define V_LOAD(P)         _mm256_loadu_ps(P)
+#define V_STORE(P,A)      _mm256_storeu_ps(P, A)
+#define V_ADD(A,B)        _mm256_add_ps(A, B)
+#define V_SUB(A,B)        _mm256_sub_ps(A, B)
+#define V_MUL(A,B)        _mm256_mul_ps(A, B)
+#define V_DIV(A,B)        _mm256_div_ps(A, B)
+#define V_FLOOR(A)        _mm256_floor_ps(A)
+#define V_TOINT(A)        _mm256_cvttps_epi32(A)
+#define V_GT(A,B)         _mm256_cmp_ps(A, B, _CMP_GT_OQ)
+#define V_GE(A,B)         _mm256_cmp_ps(A, B, _CMP_GE_OQ)
+#define V_LT(A,B)         _mm256_cmp_ps(A, B, _CMP_LT_OQ)
+#define V_LE(A,B)         _mm256_cmp_ps(A, B, _CMP_LE_OQ)
+#define V_AND(M,A)        _mm256_and_ps(M, A)
+#define V_BLEND(A,B,M)    _mm256_blendv_ps(A, B, M)
+#define VI_SET1(A)        _mm256_set1_epi32(A)
+#define VI_ADD(A,B)       _mm256_add_epi32(A, B)
+#define VI_STORE(P,A)     _mm256_storeu_si256((__m256i *)(P), A)
+#define VI_TOFLOAT(A)     _mm256_cvtepi32_ps(A)
+#define M_AND(A,B)        _mm256_and_ps(A, B)
+#define M_OR(A,B)         _mm256_or_ps(A, B)
+#define M_ANDNOT(A,B)     _mm256_andnot_ps(B, A)
+#define M_BITS(M)         (unsigned)_mm256_movemask_ps(M)
+#define M_FROM_BITS(B)    _mm256_castsi256_ps(_mm256_cmpeq_epi32( \
+                              _mm256_and_si256(_mm256_set1_epi32(B), _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128)), \
+                              _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128)))
+#include "opensimplex_sweep.h"
+#endif /* OPENSIMPLEX_SIMD */
+
+/*
+ * Adds one octave of noise at each point to out, on the widest instruction
+ * set this CPU supports.
+ */
+static void
+sweep(const struct opensimplex *osn, int dim,
+      const float *const *p, float *out, size_t n,
+      float frq, float amp)
+{
+#if OPENSIMPLEX_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        sweep_avx2(osn, dim, p, out, n, frq, amp);
+        return;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        sweep_sse41(osn, dim, p, out, n, frq, amp);
+        return;
+    }
+#endif
+    sweep_scalar(osn, dim, p, out, n, frq, amp);
+}
+
+static void
+fbm_batch(const struct opensimplex *osn, int dim,
+          const float *const *p, float *out, size_t n,
+          int oct, float per)
+{
+    float frq = 1;
+    float amp = 1;
+    for (size_t i = 0; i < n; ++ i)
+        out[i] = 0;
+    for (int o = 0; o < oct; ++ o) {
+        sweep(osn, dim, p, out, n, frq, amp);
+        amp /= per;
+        frq *= 2;
+    }
+}
+
+void
+opensimplex2_fbm_batch(const struct opensimplex *osn,
+                       const float *x, const float *y,
+                       float *out, size_t n,
+                       int oct, float per)
+{
+    const float *p[] = { x, y };
+    fbm_batch(osn, 2, p, out, n, oct, per);
+}
+
+void
+opensimplex3_fbm_batch(const struct opensimplex *osn,
+                       const float *x, const float *y, const float *z,
+                       float *out, size_t n,
+                       int oct, float per)
+{
+    const float *p[] = { x, y, z };
+    fbm_batch(osn, 3, p, out, n, oct, per);
+}
+
+void
+opensimplex4_fbm_batch(const struct opensimplex *osn,
+                       const float *x, const float *y,
+                       const float *z, const float *w,
+                       float *out, size_t n,
+                       int oct, float per)
+{
+    const float *p[] = { x, y, z, w };
+    fbm_batch(osn, 4, p, out, n, oct, per);
+}
@@ -0,0 +1,390 @@
+/*
+ * Lattice sweep kernel behind the opensimplex batch functions. This file is
+ * included by src/opensimplex.c once per instruction set, after defining:
+ *
+ *   SWEEP_NAME(N)     name of the kernel for this instruction set
+ *   SWEEP_ATTR        function attributes, e.g. the target
+ *   SWEEP_W           lanes per vector, at most 8
+ *   V_T, VI_T, M_T    float, int and mask vectors
+ *   V_* VI_* M_*      operations on them, see the includer
+ *
+ * Every instantiation performs the same operations in the same order, so
+ * results are identical whichever is chosen at runtime.
+ */
+
+/*
+ * Position D relative to lattice point P, and its attenuation ATTN, which is
+ * positive in range. Both are computed as in opensimplex2/3/4, and spelled
+ * out per axis so the vectors stay in registers.
+ */
+#define SWEEP_ATTN(D,ATTN,P) do { \
+    V_T squish = V_SET1((P)->squish); \
+    (D)[0] = V_SUB(V_SUB(d0[0], V_SET1((P)->offset[0])), squish); \
+    (D)[1] = V_SUB(V_SUB(d0[1], V_SET1((P)->offset[1])), squish); \
+    (ATTN) = V_SUB(V_SUB(V_SET1(2), V_MUL((D)[0], (D)[0])), V_MUL((D)[1], (D)[1])); \
+    if (dim > 2) { \
+        (D)[2] = V_SUB(V_SUB(d0[2], V_SET1((P)->offset[2])), squish); \
+        (ATTN) = V_SUB((ATTN), V_MUL((D)[2], (D)[2])); \
+    } \
+    if (dim > 3) { \
+        (D)[3] = V_SUB(V_SUB(d0[3], V_SET1((P)->offset[3])), squish); \
+        (ATTN) = V_SUB((ATTN), V_MUL((D)[3], (D)[3])); \
+    } \
+} while (0)
+
+/*
+ * One of the scalar variants' steps choosing the two closest vertices a and
+ * b: S with point P and flag F replaces b where KEEP_A, else a, if BETTER.
+ */
+#define SWEEP_STEP(KEEP_A,BETTER,S,P,F) do { \
+    M_T keep_a = (KEEP_A); \
+    M_T to_b = M_AND(keep_a, BETTER((S), b)); \
+    M_T to_a = M_ANDNOT(BETTER((S), a), keep_a); \
+    b  = V_BLEND(b,  (S), to_b); \
+    pb = V_BLEND(pb, (P), to_b); \
+    fb = V_BLEND(fb, (F), to_b); \
+    a  = V_BLEND(a,  (S), to_a); \
+    pa = V_BLEND(pa, (P), to_a); \
+    fa = V_BLEND(fa, (F), to_a); \
+} while (0)
+
+/*
+ * Replays the comparisons opensimplex2/3/4 make to pick the extra vertices
+ * around a point, on every lane at once. Returns for each lane the region
+ * of the super-cell, the two closest vertices and the two flags which then
+ * decide the extra vertices, packed as in lattice->select.
+ */
+static SWEEP_INLINE SWEEP_ATTR VI_T
+SWEEP_NAME(select)(int dim, const V_T *ins)
+{
+    V_T zero = V_SET1(0);
+    V_T one = V_SET1(1);
+    V_T x = ins[0], y = ins[1];
+    V_T in_sum = V_ADD(x, y);
+    V_T region, pa = zero, pb = zero;
+    M_T f0, f1;
+
+    if (dim == 2) {
+        M_T at_0 = V_LE(in_sum, one);
+        V_T z0 = V_SUB(one, in_sum);
+        V_T z1 = V_SUB(V_SET1(2), in_sum);
+        region = V_BLEND(one, zero, at_0);
+        f0 = M_OR(M_AND(at_0, M_OR(V_GT(z0, x), V_GT(z0, y))),
+                  M_ANDNOT(M_OR(V_GT(x, z1), V_GT(y, z1)), at_0));
+        f1 = V_GT(x, y);
+    } else if (dim == 3) {
+        V_T z = ins[2];
+        in_sum = V_ADD(in_sum, z);
+        V_T a, b, fa = zero, fb = zero;
+
+        /* Octahedron between the tetrahedra */
+        V_T p1 = V_ADD(x, y);
+        M_T p1_far = V_GT(p1, one);
+        a  = V_BLEND(V_SUB(one, p1), V_SUB(p1, one), p1_far);
+        pa = V_BLEND(V_SET1(0x04), V_SET1(0x03), p1_far);
+        fa = V_AND(p1_far, one);
+        V_T p2 = V_ADD(x, z);
+        M_T p2_far = V_GT(p2, one);
+        b  = V_BLEND(V_SUB(one, p2), V_SUB(p2, one), p2_far);
+        pb = V_BLEND(V_SET1(0x02), V_SET1(0x05), p2_far);
+        fb = V_AND(p2_far, one);
+        V_T p3 = V_ADD(y, z);
+        M_T p3_far = V_GT(p3, one);
+        SWEEP_STEP(V_GT(a, b), V_GT,
+                   V_BLEND(V_SUB(one, p3), V_SUB(p3, one), p3_far),
+                   V_BLEND(V_SET1(0x01), V_SET1(0x06), p3_far),
+                   V_AND(p3_far, one));
+        V_T oct_pa = pa, oct_pb = pb;
+        M_T oct_f0 = V_GT(fa, zero), oct_f1 = V_GT(fb, zero);
+
+        /* Tetrahedron at (1,1,1) */
+        a = x, pa = V_SET1(0x06);
+        b = y, pb = V_SET1(0x05);
+        SWEEP_STEP(V_LE(a, b), V_LT, z, V_SET1(0x03), zero);
+        V_T w1 = V_SUB(V_SET1(3), in_sum);
+        M_T at_1 = V_GE(in_sum, V_SET1(2));
+        V_T t1_pa = pa, t1_pb = pb;
+        M_T t1_f0 = M_OR(V_LT(w1, a), V_LT(w1, b));
+        M_T t1_f1 = V_LT(b, a);
+
+        /* Tetrahedron at (0,0,0) */
+        a = x, pa = V_SET1(0x01);
+        b = y, pb = V_SET1(0x02);
+        SWEEP_STEP(V_GE(a, b), V_GT, z, V_SET1(0x04), zero);
+        V_T w0 = V_SUB(one, in_sum);
+        M_T at_0 = V_LE(in_sum, one);
+
+        region = V_BLEND(V_BLEND(V_SET1(2), one, at_1), zero, at_0);
+        pa = V_BLEND(V_BLEND(oct_pa, t1_pa, at_1), pa, at_0);
+        pb = V_BLEND(V_BLEND(oct_pb, t1_pb, at_1), pb, at_0);
+        f0 = M_OR(M_AND(at_0, M_OR(V_GT(w0, a), V_GT(w0, b))),
+                  M_ANDNOT(M_OR(M_AND(at_1, t1_f0), M_ANDNOT(oct_f0, at_1)), at_0));
+        f1 = M_OR(M_AND(at_0, V_GT(b, a)),
+                  M_ANDNOT(M_OR(M_AND(at_1, t1_f1), M_ANDNOT(oct_f1, at_1)), at_0));
+    } else {
+        V_T z = ins[2], w = ins[3];
+        in_sum = V_ADD(V_ADD(in_sum, z), w);
+        V_T a, b, fa, fb;
+        V_T xy = V_ADD(x, y), zw = V_ADD(z, w);
+        V_T xz = V_ADD(x, z), yw = V_ADD(y, w);
+        V_T xw = V_ADD(x, w), yz = V_ADD(y, z);
+
+        /* Second dispentachoron */
+        M_T lt = V_LT(xy, zw);
+        a  = V_BLEND(zw, xy, lt);
+        pa = V_BLEND(V_SET1(0x03), V_SET1(0x0C), lt);
+        lt = V_LT(xz, yw);
+        b  = V_BLEND(yw, xz, lt);
+        pb = V_BLEND(V_SET1(0x05), V_SET1(0x0A), lt);
+        fa = fb = one;
+        lt = V_LT(xw, yz);
+        SWEEP_STEP(V_LE(a, b), V_LT, V_BLEND(yz, xw, lt),
+                   V_BLEND(V_SET1(0x09), V_SET1(0x06), lt), one);
+        V_T p = V_SUB(V_SET1(3), in_sum);
+        SWEEP_STEP(V_LE(a, b), V_LT, V_ADD(p, x), V_SET1(0x0E), zero);
+        SWEEP_STEP(V_LE(a, b), V_LT, V_ADD(p, y), V_SET1(0x0D), zero);
+        SWEEP_STEP(V_LE(a, b), V_LT, V_ADD(p, z), V_SET1(0x0B), zero);
+        SWEEP_STEP(V_LE(a, b), V_LT, V_ADD(p, w), V_SET1(0x07), zero);
+        V_T r2_pa = pa, r2_pb = pb, r2_fa = fa, r2_fb = fb;
+
+        /* First dispentachoron */
+        M_T gt = V_GT(xy, zw);
+        a  = V_BLEND(zw, xy, gt);
+        pa = V_BLEND(V_SET1(0x0C), V_SET1(0x03), gt);
+        gt = V_GT(xz, yw);
+        b  = V_BLEND(yw, xz, gt);
+        pb = V_BLEND(V_SET1(0x0A), V_SET1(0x05), gt);
+        fa = fb = one;
+        gt = V_GT(xw, yz);
+        SWEEP_STEP(V_GE(a, b), V_GT, V_BLEND(yz, xw, gt),
+                   V_BLEND(V_SET1(0x06), V_SET1(0x09), gt), one);
+        p = V_SUB(V_SET1(2), in_sum);
+        SWEEP_STEP(V_GE(a, b), V_GT, V_ADD(p, x), V_SET1(0x01), zero);
+        SWEEP_STEP(V_GE(a, b), V_GT, V_ADD(p, y), V_SET1(0x02), zero);
+        SWEEP_STEP(V_GE(a, b), V_GT, V_ADD(p, z), V_SET1(0x04), zero);
+        SWEEP_STEP(V_GE(a, b), V_GT, V_ADD(p, w), V_SET1(0x08), zero);
+        M_T at_2 = V_LE(in_sum, V_SET1(2));
+        r2_pa = V_BLEND(r2_pa, pa, at_2);
+        r2_pb = V_BLEND(r2_pb, pb, at_2);
+        M_T r2_f0 = V_GT(V_BLEND(r2_fa, fa, at_2), zero);
+        M_T r2_f1 = V_GT(V_BLEND(r2_fb, fb, at_2), zero);
+
+        /* Pentachoron at (1,1,1,1) */
+        a = x, pa = V_SET1(0x0E);
+        b = y, pb = V_SET1(0x0D);
+        fa = fb = zero;
+        SWEEP_STEP(V_LE(a, b), V_LT, z, V_SET1(0x0B), zero);
+        SWEEP_STEP(V_LE(a, b), V_LT, w, V_SET1(0x07), zero);
+        V_T u = V_SUB(V_SET1(4), in_sum);
+        M_T at_3 = V_GE(in_sum, V_SET1(3));
+        r2_pa = V_BLEND(r2_pa, pa, at_3);
+        r2_pb = V_BLEND(r2_pb, pb, at_3);
+        r2_f0 = M_OR(M_AND(at_3, M_OR(V_LT(u, a), V_LT(u, b))), M_ANDNOT(r2_f0, at_3));
+        r2_f1 = M_OR(M_AND(at_3, V_LT(b, a)), M_ANDNOT(r2_f1, at_3));
+
+        /* Pentachoron at (0,0,0,0) */
+        a = x, pa = V_SET1(0x01);
+        b = y, pb = V_SET1(0x02);
+        SWEEP_STEP(V_GE(a, b), V_GT, z, V_SET1(0x04), zero);
+        SWEEP_STEP(V_GE(a, b), V_GT, w, V_SET1(0x08), zero);
+        u = V_SUB(one, in_sum);
+        M_T at_0 = V_LE(in_sum, one);
+
+        region = V_BLEND(V_BLEND(V_BLEND(V_SET1(2), one, at_2), V_SET1(3), at_3), zero, at_0);
+        pa = V_BLEND(r2_pa, pa, at_0);
+        pb = V_BLEND(r2_pb, pb, at_0);
+        f0 = M_OR(M_AND(at_0, M_OR(V_GT(u, a), V_GT(u, b))), M_ANDNOT(r2_f0, at_0));
+        f1 = M_OR(M_AND(at_0, V_GT(b, a)), M_ANDNOT(r2_f1, at_0));
+    }
+
+    V_T key = V_ADD(region, V_ADD(V_AND(f0, V_SET1(4)), V_AND(f1, V_SET1(8))));
+    key = V_ADD(key, V_ADD(V_MUL(pa, V_SET1(16)), V_MUL(pb, V_SET1(16 << dim))));
+    return V_TOINT(key);
+}
+
+static SWEEP_INLINE SWEEP_ATTR void
+SWEEP_NAME(sweep_dim)(const struct opensimplex *osn, int dim,
+                      const float *const *p, float *out, size_t n,
+                      float frq, float amp)
+{
+    const struct lattice *lat = &lattices[dim];
+    for (size_t i = 0; i < n; i += SWEEP_W) {
+        size_t lanes = n - i < SWEEP_W ? n - i : SWEEP_W;
+
+        /* Place input coordinates onto grid, padding the last vector. */
+        float in[4][SWEEP_W] = { { 0 } };
+        for (int k = 0; k < dim; ++ k)
+            for (size_t l = 0; l < lanes; ++ l)
+                in[k][l] = p[k][i + l];
+        V_T pt[4];
+        V_T stretch = V_SET1(0);
+        for (int k = 0; k < dim; ++ k) {
+            pt[k] = V_MUL(V_LOAD(in[k]), V_SET1(frq));
+            stretch = k ? V_ADD(stretch, pt[k]) : pt[k];
+        }
+        stretch = V_MUL(stretch, V_SET1(lat->stretch));
+
+        /*
+         * Super-cell origin, position within the super-cell and position
+         * relative to its origin.
+         */
+        VI_T base[4];
+        VI_T base_sum = VI_SET1(0);
+        V_T ins[4];
+        for (int k = 0; k < dim; ++ k) {
+            V_T s = V_ADD(pt[k], stretch);
+            V_T s_floor = V_FLOOR(s);
+            base[k] = V_TOINT(s_floor);
+            base_sum = VI_ADD(base_sum, base[k]);
+            ins[k] = V_SUB(s, s_floor);
+        }
+        V_T squish = V_MUL(VI_TOFLOAT(base_sum), V_SET1(lat->squish));
+        V_T d0[4];
+        for (int k = 0; k < dim; ++ k)
+            d0[k] = V_SUB(pt[k], V_ADD(VI_TOFLOAT(base[k]), squish));
+
+        /*
+         * Only the lattice points the scalar variants would pick for some
+         * lane are visited, and each only counts for those lanes. Neighboring
+         * points mostly share a super-cell, so gradients are looked up once
+         * per distinct cell rather than once per lane.
+         */
+        int key[SWEEP_W];
+        VI_STORE(key, SWEEP_NAME(select)(dim, ins));
+        uint64_t visit[2] = { 0, 0 };
+        unsigned char point_lanes[LATTICE_MAX] = { 0 };
+        for (size_t l = 0; l < lanes; ++ l) {
+            const uint64_t *vertices = lat->vertices[lat->select[key[l]]];
+            for (size_t word = 0; word < 2; ++ word)
+            for (uint64_t bits = vertices[word]; bits; bits &= bits - 1)
+                point_lanes[word * 64 + ctz64(bits)] |= 1u << l;
+            visit[0] |= vertices[0];
+            visit[1] |= vertices[1];
+        }
+
+        int cell_base[4][SWEEP_W];
+        for (int k = 0; k < dim; ++ k)
+            VI_STORE(cell_base[k], base[k]);
+        size_t cells = 0;
+        size_t cell_lane[SWEEP_W];
+        unsigned cell_bits[SWEEP_W];
+        for (size_t l = 0; l < lanes; ++ l) {
+            size_t c = 0;
+            for (; c < cells; ++ c) {
+                int k = 0;
+                while (k < dim && cell_base[k][l] == cell_base[k][cell_lane[c]])
+                    ++ k;
+                if (k == dim)
+                    break;
+            }
+            if (c == cells) {
+                cell_lane[cells] = l;
+                cell_bits[cells ++] = 0;
+            }
+            cell_bits[c] |= 1u << l;
+        }
+
+        /* Find which lattice points are in range of some lane. */
+        uint64_t live[2] = { 0, 0 };
+        for (size_t word = 0; word < 2; ++ word)
+        for (uint64_t bits = visit[word]; bits; bits &= bits - 1) {
+            unsigned v = ctz64(bits);
+            V_T d[4], attn;
+            SWEEP_ATTN(d, attn, &lat->point[word * 64 + v]);
+            uint64_t in_range = (M_BITS(V_GT(attn, V_SET1(0))) & point_lanes[word * 64 + v]) != 0;
+            live[word] |= in_range << v;
+        }
+
+        float grad_table[SWEEP_W][LATTICE_MAX][4];
+        M_T cell_mask[SWEEP_W];
+        for (size_t c = 0; c < cells; ++ c) {
+            int cell[4];
+            for (int k = 0; k < dim; ++ k)
+                cell[k] = cell_base[k][cell_lane[c]];
+            lattice_gradients(osn, lat, dim, cell, live, grad_table[c]);
+            cell_mask[c] = M_FROM_BITS(cell_bits[c]);
+        }
+
+        /* Sum the contribution of every lattice point in range. */
+        V_T value = V_SET1(0);
+        for (size_t word = 0; word < 2; ++ word)
+        for (uint64_t bits = live[word]; bits; bits &= bits - 1) {
+            size_t v = word * 64 + ctz64(bits);
+            V_T d[4], attn;
+            SWEEP_ATTN(d, attn, &lat->point[v]);
+            M_T in_range = M_AND(V_GT(attn, V_SET1(0)), M_FROM_BITS(point_lanes[v]));
+
+            V_T grad[4];
+            for (int k = 0; k < dim; ++ k) {
+                grad[k] = V_SET1(grad_table[0][v][k]);
+                for (size_t c = 1; c < cells; ++ c)
+                    grad[k] = V_BLEND(grad[k], V_SET1(grad_table[c][v][k]), cell_mask[c]);
+            }
+            V_T extrapolate = V_ADD(V_MUL(grad[0], d[0]), V_MUL(grad[1], d[1]));
+            if (dim > 2)
+                extrapolate = V_ADD(extrapolate, V_MUL(grad[2], d[2]));
+            if (dim > 3)
+                extrapolate = V_ADD(extrapolate, V_MUL(grad[3], d[3]));
+            attn = V_MUL(attn, attn);
+            attn = V_MUL(attn, attn);
+            value = V_ADD(value, V_AND(in_range, V_MUL(attn, extrapolate)));
+        }
+
+        float result[SWEEP_W];
+        V_STORE(result, V_MUL(V_DIV(value, V_SET1(lat->norm)), V_SET1(amp)));
+        for (size_t l = 0; l < lanes; ++ l)
+            out[i + l] += result[l];
+    }
+}
+
+/* Specialized for each dimension, so vectors stay in registers */
+static SWEEP_ATTR void
+SWEEP_NAME(sweep)(const struct opensimplex *osn, int dim,
+                  const float *const *p, float *out, size_t n,
+                  float frq, float amp)
+{
+    switch (dim) {
+    case 2:
+        SWEEP_NAME(sweep_dim)(osn, 2, p, out, n, frq, amp);
+        break;
+    case 3:
+        SWEEP_NAME(sweep_dim)(osn, 3, p, out, n, frq, amp);
+        break;
+    default:
+        SWEEP_NAME(sweep_dim)(osn, 4, p, out, n, frq, amp);
+        break;
+    }
+}
+
+#undef SWEEP_NAME
+#undef SWEEP_ATTR
+#undef SWEEP_W
+#undef V_T
+#undef VI_T
+#undef M_T
+#undef V_SET1
+#undef V_LOAD
+#undef V_STORE
+#undef V_ADD
+#undef V_SUB
+#undef V_MUL
+#undef V_DIV
+#undef V_FLOOR
+#undef V_TOINT
+#undef V_GT
+#undef V_GE
+#undef V_LT
+#undef V_LE
+#undef V_AND
+#undef V_BLEND
+#undef VI_SET1
+#undef VI_ADD
+#undef VI_STORE
+#undef VI_TOFLOAT
+#undef M_AND
+#undef M_OR
+#undef M_ANDNOT
+#undef M_BITS
+#undef M_FROM_BITS
+#undef SWEEP_ATTN
+#undef SWEEP_STEP
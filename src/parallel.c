@@ -0,0 +1,106 @@
+#include "hammer/parallel.h"
+#include "hammer/math.h"
+#include <deadlock/dl.h>
+#include <stdatomic.h>
+
+/*
+ * Helpers live in .bss rather than being allocated per call, because a task
+ * may not free its own memory and the caller may have to return before a
+ * helper it spawned has even started. Any helper still queued when the
+ * caller runs out of bands is cancelled: it will eventually be invoked, find
+ * no job, and mark itself free again.
+ */
+#define PARALLEL_MAX_HELPERS 64
+
+struct parallel_job {
+	parallel_fn   fn;
+	void         *arg;
+	size_t        count;
+	size_t        grain;
+	size_t        band_count;
+	atomic_size_t next_band;
+	atomic_size_t pending; /* helpers queued or running */
+};
+
+static struct parallel_helper {
+	dltask task;
+	_Atomic(struct parallel_job *) job;
+	atomic_flag busy;
+} helpers[PARALLEL_MAX_HELPERS];
+
+static void parallel_helper_async(DL_TASK_ARGS);
+static void parallel_job_work(struct parallel_job *);
+
+void
+parallel_for(size_t count, size_t grain, parallel_fn fn, void *arg)
+{
+	if (count == 0)
+		return;
+	if (grain == 0)
+		grain = 1;
+
+	struct parallel_job job = {
+		.fn = fn,
+		.arg = arg,
+		.count = count,
+		.grain = grain,
+		.band_count = (count + grain - 1) / grain
+	};
+	atomic_init(&job.next_band, 0);
+	atomic_init(&job.pending, 0);
+
+	/* No point spawning helpers for a single band */
+	size_t want = MIN(job.band_count - 1, PARALLEL_MAX_HELPERS);
+	struct parallel_helper *taken[PARALLEL_MAX_HELPERS];
+	size_t taken_count = 0;
+	for (size_t i = 0; i < PARALLEL_MAX_HELPERS && taken_count < want; ++ i) {
+		struct parallel_helper *h = &helpers[i];
+		if (atomic_flag_test_and_set_explicit(&h->busy, memory_order_acquire))
+			continue; /* busy helping someone else */
+		atomic_fetch_add_explicit(&job.pending, 1, memory_order_relaxed);
+		h->task = DL_TASK_INIT(parallel_helper_async);
+		atomic_store_explicit(&h->job, &job, memory_order_release);
+		dlasync(&h->task);
+		taken[taken_count ++] = h;
+	}
+
+	parallel_job_work(&job);
+
+	/* Cancel helpers which never started */
+	for (size_t i = 0; i < taken_count; ++ i) {
+		struct parallel_job *expected = &job;
+		if (atomic_compare_exchange_strong(&taken[i]->job, &expected, NULL))
+			atomic_fetch_sub_explicit(&job.pending, 1, memory_order_relaxed);
+	}
+
+	/* Spinlock waiting for running helpers to finish their last band */
+	while (atomic_load_explicit(&job.pending, memory_order_acquire)) ;
+}
+
+static void
+parallel_helper_async(DL_TASK_ARGS)
+{
+	DL_TASK_ENTRY(struct parallel_helper, h, task);
+
+	struct parallel_job *job = atomic_exchange(&h->job, NULL);
+	if (job) {
+		parallel_job_work(job);
+		/* job may go out of scope as soon as pending hits zero */
+		atomic_fetch_sub_explicit(&job->pending, 1, memory_order_release);
+	}
+	atomic_flag_clear_explicit(&h->busy, memory_order_release);
+}
+
+static void
+parallel_job_work(struct parallel_job *job)
+{
+	for (;;) {
+		size_t band = atomic_fetch_add_explicit(&job->next_band, 1,
+		                                        memory_order_relaxed);
+		if (band >= job->band_count)
+			return;
+		size_t begin = band * job->grain;
+		size_t end = MIN(begin + job->grain, job->count);
+		job->fn(job->arg, begin, end);
+	}
+}
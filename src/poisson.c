@@ -1,5 +1,7 @@
+#include "hammer/error.h"
 #include "hammer/math.h"
 #include "hammer/mem.h"
+#include "hammer/parallel.h"
 #include "hammer/well.h"
 #include <stdlib.h>
 #include <string.h>
@@ -13,122 +15,304 @@
  * This is a crude implementation of:
  *  Robert Bridson, 2007. "Fast Poisson Disk Sampling in Arbitrary
  *  Dimensions." SIGGRAPH '07
+ *
+ * The domain is split into tiles, each sampled on its own with its own
+ * random stream. Tiles are colored by the parity of their coordinates and
+ * each color is sampled in parallel. Tiles sharing a color are a whole tile
+ * apart, so never touch the same grid cells, and tiles of earlier colors
+ * are finished by the time we read them. Where tiles meet, the points of
+ * earlier tiles are simply taken as given, so the result only depends upon
+ * the seed.
+ */
+
+/* Grid cells along each side of a tile, before rounding tile counts */
+#define POISSON_TILE_CELLS 32
+
+/*
+ * Children are spawned between r and 2*r of their parent, so a point may
+ * spawn children up to this many grid cells beyond its own.
  */
+#define POISSON_REACH 3
+
+/* Maximum attempts made to spawn a child point */
+#define POISSON_ATTEMPTS 8
+
+#define NO_POINT UINT32_MAX
+
+struct poisson_job {
+	float    *pt;
+	uint32_t *lookup;     /* index into pt, queried with grid coordinate */
+	uint32_t *tile_start; /* first index into pt reserved for each tile */
+	uint32_t *tile_count; /* points sampled by each tile */
+	uint64_t  seed;
+	float     r;
+	float     w, h;
+	float     cw, ch;     /* grid cell dimensions */
+	long      gw, gh;
+	long      tw, th;     /* tiles along each axis */
+	long      px, py;     /* parity of tiles currently being sampled */
+};
+
+/* A tile being sampled, spanning grid cells [x0,x1) by [y0,y1) */
+struct poisson_tile {
+	long      x0, x1, y0, y1;
+	uint32_t  start;      /* first index into pt reserved for us */
+	uint32_t  npt;
+	uint32_t *active;     /* points which have not yet spawned children */
+	size_t    nactive;
+	WELL512   rng;
+};
+
+static void poisson_tiles(void *, size_t t0, size_t t1);
+static void poisson_tile(struct poisson_job *, long tx, long ty);
+static void poisson_grow(struct poisson_job *, struct poisson_tile *);
+static int poisson_try(struct poisson_job *, struct poisson_tile *, float x, float y);
+static int poisson_fits(const struct poisson_job *, float x, float y, long gx, long gy);
+static long tile_edge(long tile, long cells, long tiles);
+static uint64_t tile_seed(uint64_t seed, uint64_t tile);
 
 void
 poisson(float **pt, size_t *ptsz, uint64_t seed, float r, float w, float h)
 {
-	WELL512 rng;
-	WELL512_seed(rng, seed);
-
 	/*
 	 * Backing grid to accelerate spacial searches stores the index into
 	 * (*pt) of the point at that location (position floored).
 	 *
-	 * Backing grid cells have length radius/sqrt(2) such that two points
-	 * farther than radius apart will never occupy the same cell.
+	 * Backing grid cells have length at most radius/sqrt(2) such that two
+	 * points farther than radius apart will never occupy the same cell.
+	 * Cells evenly divide the domain, so points within radius of one
+	 * another are never more than two cells apart, even across the wrap.
 	 */
 	float cl = r / 1.414213562f;
 	long gw = lroundf(ceilf(w / cl));
 	long gh = lroundf(ceilf(h / cl));
+	if ((uint64_t)gw * gh >= NO_POINT)
+		xpanic("Poisson grid exceeds uint32_t");
+
+	/*
+	 * An even number of tiles along each axis so colors alternate across
+	 * the wrap too, unless the domain is too small for two.
+	 */
+	long tw = gw / POISSON_TILE_CELLS;
+	long th = gh / POISSON_TILE_CELLS;
+	tw = tw < 2 ? 1 : tw - tw % 2;
+	th = th < 2 ? 1 : th - th % 2;
+
+	struct poisson_job job = {
+		.seed = seed,
+		.r = r,
+		.w = w,
+		.h = h,
+		.cw = w / gw,
+		.ch = h / gh,
+		.gw = gw,
+		.gh = gh,
+		.tw = tw,
+		.th = th
+	};
+
+	/*
+	 * Each cell holds at most one point, so each tile reserves as many
+	 * points as it has cells.
+	 */
+	job.pt = xmalloc(2 * gw * gh * sizeof(*job.pt));
+	job.lookup = xmalloc(gw * gh * sizeof(*job.lookup));
+	memset(job.lookup, 0xFF, gw * gh * sizeof(*job.lookup));
+	job.tile_start = xmalloc(tw * th * sizeof(*job.tile_start));
+	job.tile_count = xmalloc(tw * th * sizeof(*job.tile_count));
+	uint32_t reserved = 0;
+	for (long ty = 0; ty < th; ++ ty)
+	for (long tx = 0; tx < tw; ++ tx) {
+		long cells = (tile_edge(tx+1, gw, tw) - tile_edge(tx, gw, tw)) *
+		             (tile_edge(ty+1, gh, th) - tile_edge(ty, gh, th));
+		job.tile_start[ty * tw + tx] = reserved;
+		reserved += cells;
+	}
+
+	for (job.py = 0; job.py < 2; ++ job.py)
+	for (job.px = 0; job.px < 2; ++ job.px) {
+		size_t count = (tw - job.px + 1) / 2 * ((th - job.py + 1) / 2);
+		parallel_for(count, 1, poisson_tiles, &job);
+	}
 
-	/* Buffer for points, with reasonable maximum count of area */
-	size_t mxnpt = gw * gh;
-	*pt = xmalloc(2 * mxnpt * sizeof **pt);
+	/* Pack each tile's points together, in tile order */
 	size_t npt = 0;
+	for (long t = 0; t < tw * th; ++ t) {
+		memmove(job.pt + 2 * npt, job.pt + 2 * (size_t)job.tile_start[t],
+		        2 * job.tile_count[t] * sizeof(*job.pt));
+		npt += job.tile_count[t];
+	}
+
+	/* Reclaimed unused points */
+	*pt = xrealloc(job.pt, 2 * npt * sizeof **pt);
+	*ptsz = npt;
+
+	free(job.tile_count);
+	free(job.tile_start);
+	free(job.lookup);
+}
+
+static void
+poisson_tiles(void *arg, size_t t0, size_t t1)
+{
+	struct poisson_job *job = arg;
+	size_t across = (job->tw - job->px + 1) / 2;
+	for (size_t t = t0; t < t1; ++ t) {
+		long tx = job->px + 2 * (long)(t % across);
+		long ty = job->py + 2 * (long)(t / across);
+		poisson_tile(job, tx, ty);
+	}
+}
+
+static void
+poisson_tile(struct poisson_job *job, long tx, long ty)
+{
+	const size_t t = ty * job->tw + tx;
+	struct poisson_tile tile = {
+		.x0 = tile_edge(tx,   job->gw, job->tw),
+		.x1 = tile_edge(tx+1, job->gw, job->tw),
+		.y0 = tile_edge(ty,   job->gh, job->th),
+		.y1 = tile_edge(ty+1, job->gh, job->th),
+		.start = job->tile_start[t]
+	};
+	WELL512_seed(tile.rng, tile_seed(job->seed, t));
+
+	/*
+	 * Points of neighboring tiles close enough to spawn children within
+	 * this tile are our first parents, so we grow seamlessly from their
+	 * edge.
+	 */
+	size_t mxactive = (tile.x1 - tile.x0 + 2 * POISSON_REACH) *
+	                  (tile.y1 - tile.y0 + 2 * POISSON_REACH);
+	tile.active = xmalloc(mxactive * sizeof(*tile.active));
+	for (long y = tile.y0 - POISSON_REACH; y < tile.y1 + POISSON_REACH; ++ y)
+	for (long x = tile.x0 - POISSON_REACH; x < tile.x1 + POISSON_REACH; ++ x) {
+		long wx = wrapidx(x, job->gw);
+		long wy = wrapidx(y, job->gh);
+		if (wx >= tile.x0 && wx < tile.x1 && wy >= tile.y0 && wy < tile.y1)
+			continue;
+		uint32_t ni = job->lookup[wy * job->gw + wx];
+		if (ni != NO_POINT)
+			tile.active[tile.nactive ++] = ni;
+	}
+	poisson_grow(job, &tile);
 
-	/* Index into pt, queried with grid coordinate */
-	size_t *lookup = xmalloc(gw * gh * sizeof *lookup);
-
-	/* Active list of points that have not yet spawned children */
-	size_t *active = xmalloc(gw * gh * sizeof *active);
-	size_t nactive = 0;
-
-	/* Assign initial values to SIZE_MAX, which means no point */
-	memset(lookup, 0xFF, gw * gh * sizeof *lookup);
-
-	/* Prime with one random point */
-	{
-		float strtx = WELL512f(rng) * w;
-		float strty = WELL512f(rng) * h;
-		long gridx = lroundf(floorf(strtx / cl));
-		long gridy = lroundf(floorf(strty / cl));
-		(*pt)[0] = strtx;
-		(*pt)[1] = strty;
-		lookup[gridy * gw + gridx] = 0;
-		active[0] = 0;
-		npt = 1;
-		nactive = 1;
+	/*
+	 * Growth can stall leaving holes, or never reach into the tile at
+	 * all. Throw a point into every empty cell and grow from any which
+	 * fit.
+	 */
+	for (long y = tile.y0; y < tile.y1; ++ y)
+	for (long x = tile.x0; x < tile.x1; ++ x) {
+		if (job->lookup[y * job->gw + x] != NO_POINT)
+			continue;
+		float px = (x + WELL512f(tile.rng)) * job->cw;
+		float py = (y + WELL512f(tile.rng)) * job->ch;
+		if (poisson_try(job, &tile, px, py))
+			poisson_grow(job, &tile);
 	}
 
-	do {
-		float *parent = (*pt) + 2*active[-- nactive];
+	job->tile_count[t] = tile.npt;
+	free(tile.active);
+}
+
+/* Spawns children from the active list until it's exhausted */
+static void
+poisson_grow(struct poisson_job *job, struct poisson_tile *tile)
+{
+	while (tile->nactive) {
+		const float *parent = job->pt + 2*(size_t)tile->active[-- tile->nactive];
 
-		/* Maximum attempts made to spawn a child point */
-		size_t max_attempts = 8;
-		for (size_t i = 0; i < max_attempts && npt < mxnpt; ++ i) {
+		for (size_t i = 0; i < POISSON_ATTEMPTS; ++ i) {
 			/* Calculate a new point between r and 2*r */
-			float dist = r * (1 + WELL512f(rng));
-			float angle = 6.28318530717958647692f * WELL512f(rng);
+			float dist = job->r * (1 + WELL512f(tile->rng));
+			float angle = 6.28318530717958647692f * WELL512f(tile->rng);
 			float childx = parent[0] + cosf(angle) * dist;
 			float childy = parent[1] + sinf(angle) * dist;
 
 			/* Wrap child coords to domain */
 			while (childx < 0)
-				childx += w;
+				childx += job->w;
 			while (childy < 0)
-				childy += h;
-			childx = fmodf(childx, w);
-			childy = fmodf(childy, h);
-
-			long gridx = lroundf(floorf(childx / cl));
-			long gridy = lroundf(floorf(childy / cl));
-
-			int gridi = gridy * gw + gridx;
-			int intersect = 0;
-			/* TODO: Doesn't need to check corner neighbors */
-			for (int ny = -2; ny <= 2 && !intersect; ++ ny)
-			for (int nx = -2; nx <= 2 && !intersect; ++ nx) {
-				size_t ni = lookup[wrapidx(gridy+ny,gh) * gw +
-				                   wrapidx(gridx+nx,gw)];
-				if (ni == SIZE_MAX)
-					continue;
-				float *n = (*pt) + 2*ni;
-				float dx = fabsf(childx - n[0]);
-				float dy = fabsf(childy - n[1]);
-				/*
-				 * Not perfect; attempt to handle edge
-				 * wrapping by determining if these cells are
-				 * so far away they must be wrapped. If we're
-				 * searching for neighbors 2 cells away then a
-				 * neighbor can be at most 3 full cells away.
-				 */
-				if (dx > cl * 3)
-					dx = w - dx;
-				if (dy > cl * 3)
-					dy = h - dy;
-				if (hypotf(dx, dy) < r)
-					intersect = 1;
-			}
-
-			/* This point is within radius of a neighbor */
-			if (intersect)
-				continue;
-
-			/* This is a valid point */
-			(*pt)[npt*2+0] = childx;
-			(*pt)[npt*2+1] = childy;
-			active[nactive ++] = npt;
-			lookup[gridi] = npt;
-			++ npt;
+				childy += job->h;
+			childx = fmodf(childx, job->w);
+			childy = fmodf(childy, job->h);
+
+			poisson_try(job, tile, childx, childy);
 		}
-	} while (nactive && npt < mxnpt);
+	}
+}
 
-	/* Reclaimed unused points */
-	float *newpt = xrealloc(*pt, 2 * npt * sizeof **pt);
-	*pt = newpt;
-	*ptsz = npt;
+/*
+ * Adds the point (x,y) if it lies within the tile and beyond radius of every
+ * other point, returning whether it was added.
+ */
+static int
+poisson_try(struct poisson_job *job, struct poisson_tile *tile, float x, float y)
+{
+	if (x >= job->w || y >= job->h)
+		return 0;
+	long gx = MIN(lroundf(floorf(x / job->cw)), job->gw - 1);
+	long gy = MIN(lroundf(floorf(y / job->ch)), job->gh - 1);
+
+	/* Only spawn within this tile */
+	if (gx < tile->x0 || gx >= tile->x1 || gy < tile->y0 || gy >= tile->y1)
+		return 0;
+
+	/* This point is within radius of a neighbor */
+	if (!poisson_fits(job, x, y, gx, gy))
+		return 0;
+
+	/* This is a valid point */
+	uint32_t pi = tile->start + tile->npt ++;
+	job->pt[pi*2+0] = x;
+	job->pt[pi*2+1] = y;
+	job->lookup[gy * job->gw + gx] = pi;
+	tile->active[tile->nactive ++] = pi;
+	return 1;
+}
+
+/* Whether the point (x,y) in grid cell (gx,gy) is beyond radius of all others */
+static int
+poisson_fits(const struct poisson_job *job, float x, float y, long gx, long gy)
+{
+	/* TODO: Doesn't need to check corner neighbors */
+	for (long ny = -2; ny <= 2; ++ ny)
+	for (long nx = -2; nx <= 2; ++ nx) {
+		uint32_t ni = job->lookup[wrapidx(gy+ny, job->gh) * job->gw +
+		                          wrapidx(gx+nx, job->gw)];
+		if (ni == NO_POINT)
+			continue;
+		const float *n = job->pt + 2*(size_t)ni;
+		float dx = fabsf(x - n[0]);
+		float dy = fabsf(y - n[1]);
+		/* Nearest image across the wrap */
+		if (dx > job->w / 2)
+			dx = job->w - dx;
+		if (dy > job->h / 2)
+			dy = job->h - dy;
+		if (hypotf(dx, dy) < job->r)
+			return 0;
+	}
+	return 1;
+}
+
+/* First grid cell of a tile, spreading any remainder cells over all tiles */
+static long
+tile_edge(long tile, long cells, long tiles)
+{
+	return tile * cells / tiles;
+}
 
-	free(active);
-	free(lookup);
+/*
+ * WELL512_seed only takes the low 32 bits, so mix every bit of the seed and
+ * tile index into those.
+ */
+static uint64_t
+tile_seed(uint64_t seed, uint64_t tile)
+{
+	uint64_t z = seed + (tile + 1) * 0x9E3779B97F4A7C15ull;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
 }
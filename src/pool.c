@@ -1,63 +1,171 @@
+#ifndef _WIN32
+/* MAP_ANONYMOUS is an extension to POSIX.1-2001 */
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+#endif
+
 #include "hammer/pool.h"
 #include "hammer/mem.h"
 #include <math.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h> /* VirtualAlloc */
+#else
+#include <sys/mman.h> /* mmap */
+#endif
+
+static void *pool_page_map  (size_t bytes);
+static void  pool_page_unmap(void *mem, size_t bytes);
+
+/*
+ * Pages are mapped from the OS rather than malloc'd. Pages of chunks are
+ * megabytes, which the allocator might keep around after they're freed (or
+ * not, depending upon its mmap threshold), so evicting chunks wouldn't
+ * reliably shrink the process. Unmapping them always does.
+ */
+static void *
+pool_page_map(size_t bytes)
+{
+#ifdef _WIN32
+	void *mem = VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT,
+	                         PAGE_READWRITE);
+	if (mem == NULL)
+		xpanicva("VirtualAlloc failed to allocate %zu bytes", bytes);
+#else
+	void *mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+	                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		xpanicva("mmap failed to allocate %zu bytes", bytes);
+#endif
+	return mem;
+}
 
 static void
+pool_page_unmap(void *mem, size_t bytes)
+{
+#ifdef _WIN32
+	(void) bytes;
+	if (!VirtualFree(mem, 0, MEM_RELEASE))
+		xperror("Error releasing pool page");
+#else
+	if (munmap(mem, bytes))
+		xperror("Error unmapping pool page");
+#endif
+}
+
+static struct pool_page *
 pool_grow(struct pool *p)
 {
 	size_t np = p->pages_count ++;
 	p->pages = xrealloc(p->pages, p->pages_count * sizeof(*p->pages));
-	p->pages[np] = xcalloc(POOL_PAGE_SIZE, p->structsize);
-	/* Freelist should be empty. Fill with this page. */
-	p->freehead = p->pages[np];
-	void **next = (void **)p->freehead;
-	for (size_t i = 1; i < POOL_PAGE_SIZE-1; ++ i) {
-		*next = (char *)p->pages[np] + i*p->structsize;
+	struct pool_page *page = &p->pages[np];
+	page->mem = pool_page_map(p->page_len * p->structsize);
+	page->taken = 0;
+	/* Freelist is this entire page */
+	page->freehead = page->mem;
+	void **next = (void **)page->freehead;
+	for (size_t i = 1; i < p->page_len; ++ i) {
+		*next = page->mem + i*p->structsize;
 		next = (void **)*next;
 	}
 	*next = NULL;
+	return page;
+}
+
+/* Page containing data, pages are few enough to simply search */
+static size_t
+pool_page_of(const struct pool *p, const void *data)
+{
+	const char *d = data;
+	const size_t page_bytes = p->page_len * p->structsize;
+	for (size_t i = 0; i < p->pages_count; ++ i) {
+		if (d >= p->pages[i].mem && d < p->pages[i].mem + page_bytes)
+			return i;
+	}
+	xpanic("Data returned to pool it wasn't taken from");
+}
+
+static void
+pool_release(struct pool *p, size_t pi)
+{
+	pool_page_unmap(p->pages[pi].mem, p->page_len * p->structsize);
+	-- p->pages_count;
+	memmove(p->pages + pi, p->pages + pi + 1,
+	        (p->pages_count - pi) * sizeof(*p->pages));
+	if (p->first_free > pi)
+		-- p->first_free;
 }
 
 void
 pool_create(struct pool *p, size_t structsize)
+{
+	pool_create_paged(p, structsize, POOL_PAGE_SIZE);
+}
+
+void
+pool_create_paged(struct pool *p, size_t structsize, size_t page_len)
 {
 	/* Ensure we can alias our linked list */
 	const size_t align = sizeof(void *);
 	structsize = ceilf(structsize / (float)align) * align;
 
-	/* Allocate initial page */
+	/* Pages are allocated on demand */
 	p->pages = NULL;
-	p->freehead = NULL;
 	p->structsize = structsize;
+	p->page_len = page_len;
 	p->pages_count = 0;
-	pool_grow(p);
+	p->first_free = 0;
+	p->has_empty = 0;
 }
 
 void
 pool_destroy(struct pool *p)
 {
+	for (size_t i = 0; i < p->pages_count; ++ i)
+		pool_page_unmap(p->pages[i].mem, p->page_len * p->structsize);
 	free(p->pages);
 }
 
 void *
 pool_take(struct pool *p)
 {
-	if (p->freehead == NULL)
-		pool_grow(p);
+	while (p->first_free < p->pages_count &&
+	       p->pages[p->first_free].freehead == NULL)
+		++ p->first_free;
+	struct pool_page *page = p->first_free < p->pages_count
+	                       ? &p->pages[p->first_free]
+	                       : pool_grow(p);
+	/* A page with nothing taken can only be the empty page we held */
+	if (page->taken ++ == 0)
+		p->has_empty = 0;
 
 	/* Pop the top from our free list */
-	void *taken = p->freehead;
-	p->freehead = *(void **)p->freehead;
+	void *taken = page->freehead;
+	page->freehead = *(void **)page->freehead;
 	return taken;
 }
 
 void
 pool_give(struct pool *p, void *data)
 {
+	size_t pi = pool_page_of(p, data);
+	struct pool_page *page = &p->pages[pi];
+
 	/*
 	 * The returned memory becomes the head of our free list. This way we
 	 * don't need to traverse our list or check whether freehead is NULL.
 	 */
-	*(void **)data = p->freehead;
-	p->freehead = data;
+	*(void **)data = page->freehead;
+	page->freehead = data;
+	if (pi < p->first_free)
+		p->first_free = pi;
+
+	if (-- page->taken == 0) {
+		if (p->has_empty)
+			pool_release(p, pi);
+		else
+			p->has_empty = 1;
+	}
 }
@@ -1,5 +1,8 @@
+#include "hammer/blur.h"
 #include "hammer/math.h"
 #include "hammer/mem.h"
+#include "hammer/neighborhood.h"
+#include "hammer/parallel.h"
 #include "hammer/worldgen/climate.h"
 #include "hammer/worldgen/tectonic.h"
 #include <stddef.h>
@@ -7,6 +10,14 @@
 #include <stdio.h>
 #include <string.h>
 
+/* Vectorized interior of the flow pass, chosen at runtime */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CLIMATE_SIMD 1
+#include <immintrin.h>
+#else
+#define CLIMATE_SIMD 0
+#endif
+
 /*
  * TODO: Document; I'm unhappy with this climate model so I won't bother doing
  * much with it until I fix it.
@@ -20,12 +31,30 @@
 #define RATE_OF_FLOW          0.15f
 #define RATE_OF_TEMP_XFER     0.02f
 
+/*
+ * Every pass over the climate map is split into bands of rows which are
+ * processed in parallel, see parallel_for(). A pass only ever writes cells in
+ * its own band, so passes which read neighboring cells are kept separate.
+ */
+#define CLIMATE_BAND_ROWS 16
+
 static void advection(struct climate *);
+static void advection_rows(void *, size_t y0, size_t y1);
+static void advection_commit_rows(void *, size_t y0, size_t y1);
 static void equalize_temperature(struct climate *);
+static void equalize_temperature_outflow_rows(void *, size_t y0, size_t y1);
+static void equalize_temperature_flow_rows(void *, size_t y0, size_t y1);
+static void equalize_temperature_flow_border(struct climate *, size_t x, size_t y);
+static void equalize_temperature_flow_interior(struct climate *, size_t i, size_t end);
+#if CLIMATE_SIMD
+static void equalize_temperature_flow_interior_sse(struct climate *, size_t i, size_t end);
+static void equalize_temperature_flow_interior_avx(struct climate *, size_t i, size_t end);
+#endif
 static float latitude_temperature(float latitude);
-static void precipitation(struct climate *);
+static void precipitation(struct climate *, size_t y0, size_t y1);
 static void temperature_init(struct climate *);
-static void temperature_update(struct climate *);
+static void temperature_update(struct climate *, size_t y0, size_t y1);
+static void climate_update_rows(void *, size_t y0, size_t y1);
 
 void
 climate_create(struct climate *c, struct lithosphere *l)
@@ -52,12 +81,19 @@ void
 climate_update(struct climate *c)
 {
 	++ c->generation;
-	temperature_update(c);
-	precipitation(c);
+	parallel_for(CLIMATE_LEN, CLIMATE_BAND_ROWS, climate_update_rows, c);
 	equalize_temperature(c);
 	advection(c);
 }
 
+static void
+climate_update_rows(void *arg, size_t y0, size_t y1)
+{
+	struct climate *c = arg;
+	temperature_update(c, y0, y1);
+	precipitation(c, y0, y1);
+}
+
 static float
 lerp(float x, float y, const float *map)
 {
@@ -65,10 +101,14 @@ lerp(float x, float y, const float *map)
 	float fy = floorf(y);
 	float cx = ceilf(x);
 	float cy = ceilf(y);
-	float m00 = map[wrapidx(fy, CLIMATE_LEN) * CLIMATE_LEN + wrapidx(fx, CLIMATE_LEN)];
-	float m10 = map[wrapidx(fy, CLIMATE_LEN) * CLIMATE_LEN + wrapidx(cx, CLIMATE_LEN)];
-	float m01 = map[wrapidx(cy, CLIMATE_LEN) * CLIMATE_LEN + wrapidx(fx, CLIMATE_LEN)];
-	float m11 = map[wrapidx(cy, CLIMATE_LEN) * CLIMATE_LEN + wrapidx(cx, CLIMATE_LEN)];
+	size_t xf = WRAPIDX_POW2(fx, CLIMATE_SCALE);
+	size_t xc = WRAPIDX_POW2(cx, CLIMATE_SCALE);
+	size_t yf = WRAPIDX_POW2(fy, CLIMATE_SCALE);
+	size_t yc = WRAPIDX_POW2(cy, CLIMATE_SCALE);
+	float m00 = map[yf * CLIMATE_LEN + xf];
+	float m10 = map[yf * CLIMATE_LEN + xc];
+	float m01 = map[yc * CLIMATE_LEN + xf];
+	float m11 = map[yc * CLIMATE_LEN + xc];
 	float m0 = m00 + (m10 - m00) * (x - fx);
 	float m1 = m01 + (m11 - m01) * (x - fx);
 	return m0 + (m1 - m0) * (y - fy);
@@ -78,79 +118,299 @@ static void
 advection(struct climate *c)
 {
 	/* Note: Uses wind_velocity as scratch */
-	for (size_t y = 0; y < CLIMATE_LEN; ++ y)
+	parallel_for(CLIMATE_LEN, CLIMATE_BAND_ROWS, advection_rows, c);
+	parallel_for(CLIMATE_LEN, CLIMATE_BAND_ROWS, advection_commit_rows, c);
+}
+
+static void
+advection_rows(void *arg, size_t y0, size_t y1)
+{
+	struct climate *c = arg;
+	for (size_t y = y0; y < y1; ++ y)
 	for (size_t x = 0; x < CLIMATE_LEN; ++ x) {
 		size_t i = y * CLIMATE_LEN + x;
 		float u = x - (1/RATE_OF_FLOW)*c->wind_velocity[i*2+0];
 		float v = y - (1/RATE_OF_FLOW)*c->wind_velocity[i*2+1];
 		c->wind_velocity[i*2+0] = lerp(u, v, c->moisture);
 	}
+}
 
-	for (size_t i = 0; i < CLIMATE_AREA; ++ i)
+static void
+advection_commit_rows(void *arg, size_t y0, size_t y1)
+{
+	struct climate *c = arg;
+	for (size_t i = y0 * CLIMATE_LEN; i < y1 * CLIMATE_LEN; ++ i)
 		c->moisture[i] = c->wind_velocity[i*2+0];
 }
 
 static void
 equalize_temperature(struct climate *c)
 {
-	/* Calculate outflow */
-	for (size_t y = 0; y < CLIMATE_LEN; ++ y)
-	for (size_t x = 0; x < CLIMATE_LEN; ++ x) {
+	/*
+	 * Calculating outflow only reads temperature and only writes to each
+	 * cell's own outflow, and flow is performed by each cell gathering
+	 * inflow from its neighbors, so neither pass races with itself.
+	 */
+	parallel_for(CLIMATE_LEN, CLIMATE_BAND_ROWS,
+	             equalize_temperature_outflow_rows, c);
+	parallel_for(CLIMATE_LEN, CLIMATE_BAND_ROWS,
+	             equalize_temperature_flow_rows, c);
+}
+
+static inline void
+equalize_temperature_outflow(struct climate *c, size_t i,
+                             const uint32_t n[VON_NEUMANN_NEIGHBORHOOD_SIZE],
+                             float trade_wind_bias)
+{
+	float t = c->inv_temp[i];
+	float *out = c->inv_temp_flow + i*4;
+	float outflow = 0;
+	for (size_t a = 0; a < VON_NEUMANN_NEIGHBORHOOD_SIZE; ++ a) {
+		float flow = RATE_OF_FLOW * (t - c->inv_temp[n[a]]);
+		/* Disproportionately weight with trade wind */
+		if (a == VON_NEUMANN_NEIGHBOR_W)
+			flow *= 1 - trade_wind_bias;
+		else if (a == VON_NEUMANN_NEIGHBOR_E)
+			flow *= trade_wind_bias;
+		flow = MAX(flow, 0);
+		out[a] += flow;
+		outflow += out[a];
+	}
+	if (outflow != 0 && outflow > t) {
+		float s = t / outflow;
+		for (size_t a = 0; a < 4; ++ a)
+			out[a] *= s;
+	}
+}
+
+static void
+equalize_temperature_outflow_rows(void *arg, size_t y0, size_t y1)
+{
+	struct climate *c = arg;
+	for (size_t y = y0; y < y1; ++ y) {
 		float trade_wind_bias = cosf(M_PI * (2.0f * y / CLIMATE_LEN - 1));
-		size_t i = y * CLIMATE_LEN + x;
-		float t = c->inv_temp[i];
-		float d[4] = {
-			t - c->inv_temp[y * CLIMATE_LEN + wrapidx((long long)x-1, CLIMATE_LEN)],
-			t - c->inv_temp[y * CLIMATE_LEN + wrapidx((long long)x+1, CLIMATE_LEN)],
-			t - c->inv_temp[wrapidx((long long)y-1, CLIMATE_LEN) * CLIMATE_LEN + x],
-			t - c->inv_temp[wrapidx((long long)y+1, CLIMATE_LEN) * CLIMATE_LEN + x]
-		};
-		float *out = c->inv_temp_flow + i*4;
-		float outflow = 0;
-		for (size_t a = 0; a < 4; ++ a) {
-			float flow = RATE_OF_FLOW * d[a];
-			/* Disproportionately weight with trade wind */
-			if (a == 0)
-				flow *= 1 - trade_wind_bias;
-			else if (a == 1)
-				flow *= trade_wind_bias;
-			flow = MAX(flow, 0);
-			out[a] += flow;
-			outflow += out[a];
+		for (size_t x = 0; x < CLIMATE_LEN; ++ x) {
+			uint32_t n[VON_NEUMANN_NEIGHBORHOOD_SIZE];
+			von_neumann_neighbors_pow2(n, x, y, CLIMATE_SCALE);
+			equalize_temperature_outflow(c, y * CLIMATE_LEN + x, n,
+			                             trade_wind_bias);
 		}
-		if (outflow != 0 && outflow > t) {
-			float s = t / outflow;
-			for (size_t a = 0; a < 4; ++ a)
-				out[a] *= s;
+	}
+}
+
+static void
+equalize_temperature_flow_rows(void *arg, size_t y0, size_t y1)
+{
+	struct climate *c = arg;
+	for (size_t y = y0; y < y1; ++ y) {
+		if (y == 0 || y == CLIMATE_LEN - 1) {
+			for (size_t x = 0; x < CLIMATE_LEN; ++ x)
+				equalize_temperature_flow_border(c, x, y);
+			continue;
 		}
+		size_t row = y * CLIMATE_LEN;
+		equalize_temperature_flow_border(c, 0, y);
+#if CLIMATE_SIMD
+		if (__builtin_cpu_supports("avx"))
+			equalize_temperature_flow_interior_avx(c, row + 1, row + CLIMATE_LEN - 1);
+		else
+			equalize_temperature_flow_interior_sse(c, row + 1, row + CLIMATE_LEN - 1);
+#else
+		equalize_temperature_flow_interior(c, row + 1, row + CLIMATE_LEN - 1);
+#endif
+		equalize_temperature_flow_border(c, CLIMATE_LEN - 1, y);
 	}
+}
 
-	/* Perform flow, velocity */
-	for (size_t y = 0; y < CLIMATE_LEN; ++ y)
-	for (size_t x = 0; x < CLIMATE_LEN; ++ x) {
-		size_t i = y * CLIMATE_LEN + x;
-		float *out = c->inv_temp_flow + i*4;
-		c->inv_temp[i] -= out[0] + out[1] + out[2] + out[3];
-		size_t n[4] = {
-			y * CLIMATE_LEN + wrapidx((long long)x-1, CLIMATE_LEN),
-			y * CLIMATE_LEN + wrapidx((long long)x+1, CLIMATE_LEN),
-			wrapidx((long long)y-1, CLIMATE_LEN) * CLIMATE_LEN + x,
-			wrapidx((long long)y+1, CLIMATE_LEN) * CLIMATE_LEN + x
-		};
-		for (size_t a = 0; a < 4; ++ a)
-			c->inv_temp[n[a]] += out[a];
-		float in[4] = {
-			c->inv_temp_flow[n[0]*4+1],
-			c->inv_temp_flow[n[1]*4+0],
-			c->inv_temp_flow[n[2]*4+3],
-			c->inv_temp_flow[n[3]*4+2]
-		};
-		/* Central difference gives us velocity */
-		c->wind_velocity[2*i+0] = 0.5f * (in[0] - out[0] + out[1] - in[1]);
-		c->wind_velocity[2*i+1] = 0.5f * (in[2] - out[2] + out[3] - in[3]);
+/*
+ * Flow used to be performed by each cell scattering outflow to its neighbors
+ * in row-major order. To remain identical we gather inflow and apply it in
+ * that same order: neighbors preceding this cell, this cell's outflow, then
+ * neighbors following it. For a cell on the border of the map that order is
+ * only known once its neighbors have wrapped, so they're sorted by index.
+ */
+static void
+equalize_temperature_flow_border(struct climate *c, size_t x, size_t y)
+{
+	size_t i = y * CLIMATE_LEN + x;
+	float *out = c->inv_temp_flow + i*4;
+	uint32_t n[VON_NEUMANN_NEIGHBORHOOD_SIZE];
+	von_neumann_neighbors_pow2(n, x, y, CLIMATE_SCALE);
+	float in[VON_NEUMANN_NEIGHBORHOOD_SIZE] = {
+		c->inv_temp_flow[n[VON_NEUMANN_NEIGHBOR_W]*4+VON_NEUMANN_NEIGHBOR_E],
+		c->inv_temp_flow[n[VON_NEUMANN_NEIGHBOR_E]*4+VON_NEUMANN_NEIGHBOR_W],
+		c->inv_temp_flow[n[VON_NEUMANN_NEIGHBOR_N]*4+VON_NEUMANN_NEIGHBOR_S],
+		c->inv_temp_flow[n[VON_NEUMANN_NEIGHBOR_S]*4+VON_NEUMANN_NEIGHBOR_N]
+	};
+
+	struct inflow { size_t i; float d; } f[5] = {
+		{ n[VON_NEUMANN_NEIGHBOR_N], in[VON_NEUMANN_NEIGHBOR_N] },
+		{ n[VON_NEUMANN_NEIGHBOR_W], in[VON_NEUMANN_NEIGHBOR_W] },
+		{ i, -(out[0] + out[1] + out[2] + out[3]) },
+		{ n[VON_NEUMANN_NEIGHBOR_E], in[VON_NEUMANN_NEIGHBOR_E] },
+		{ n[VON_NEUMANN_NEIGHBOR_S], in[VON_NEUMANN_NEIGHBOR_S] }
+	};
+	for (size_t a = 1; a < 5; ++ a)
+	for (size_t b = a; b > 0 && f[b-1].i > f[b].i; -- b) {
+		struct inflow tmp = f[b];
+		f[b] = f[b-1];
+		f[b-1] = tmp;
+	}
+	float t = c->inv_temp[i];
+	for (size_t a = 0; a < 5; ++ a)
+		t += f[a].d;
+	c->inv_temp[i] = t;
+
+	/* Central difference gives us velocity */
+	c->wind_velocity[2*i+0] = 0.5f * (in[VON_NEUMANN_NEIGHBOR_W] - out[VON_NEUMANN_NEIGHBOR_W] +
+	                                  out[VON_NEUMANN_NEIGHBOR_E] - in[VON_NEUMANN_NEIGHBOR_E]);
+	c->wind_velocity[2*i+1] = 0.5f * (in[VON_NEUMANN_NEIGHBOR_N] - out[VON_NEUMANN_NEIGHBOR_N] +
+	                                  out[VON_NEUMANN_NEIGHBOR_S] - in[VON_NEUMANN_NEIGHBOR_S]);
+}
+
+/*
+ * Cells [i,end) of a row which don't touch the border of the map, whose
+ * neighbors are always north, west, east then south in row-major order.
+ * The vector kernels below add in the same order, lane by lane, so every
+ * path writes identical results.
+ */
+static void
+equalize_temperature_flow_interior(struct climate *c, size_t i, size_t end)
+{
+	const float *flow = c->inv_temp_flow;
+	for (; i < end; ++ i) {
+		const float *out = flow + i*4;
+		float in_w = flow[(i - 1)*4 + VON_NEUMANN_NEIGHBOR_E];
+		float in_e = flow[(i + 1)*4 + VON_NEUMANN_NEIGHBOR_W];
+		float in_n = flow[(i - CLIMATE_LEN)*4 + VON_NEUMANN_NEIGHBOR_S];
+		float in_s = flow[(i + CLIMATE_LEN)*4 + VON_NEUMANN_NEIGHBOR_N];
+		float t = c->inv_temp[i];
+		t += in_n;
+		t += in_w;
+		t -= out[0] + out[1] + out[2] + out[3];
+		t += in_e;
+		t += in_s;
+		c->inv_temp[i] = t;
+		c->wind_velocity[2*i+0] = 0.5f * (in_w - out[VON_NEUMANN_NEIGHBOR_W] +
+		                                  out[VON_NEUMANN_NEIGHBOR_E] - in_e);
+		c->wind_velocity[2*i+1] = 0.5f * (in_n - out[VON_NEUMANN_NEIGHBOR_N] +
+		                                  out[VON_NEUMANN_NEIGHBOR_S] - in_s);
+	}
+}
+
+#if CLIMATE_SIMD
+/* Transposes the flow of four cells from p into one vector per direction */
+__attribute__((target("sse")))
+static inline void
+flow_load4_sse(__m128 v[4], const float *p)
+{
+	v[0] = _mm_loadu_ps(p +  0);
+	v[1] = _mm_loadu_ps(p +  4);
+	v[2] = _mm_loadu_ps(p +  8);
+	v[3] = _mm_loadu_ps(p + 12);
+	_MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+}
+
+__attribute__((target("sse")))
+static void
+equalize_temperature_flow_interior_sse(struct climate *c, size_t i, size_t end)
+{
+	const float *flow = c->inv_temp_flow;
+	const __m128 half = _mm_set1_ps(0.5f);
+	for (; i + 4 <= end; i += 4) {
+		__m128 out[4], w[4], e[4], n[4], s[4];
+		flow_load4_sse(out, flow + i*4);
+		flow_load4_sse(w, flow + (i - 1)*4);
+		flow_load4_sse(e, flow + (i + 1)*4);
+		flow_load4_sse(n, flow + (i - CLIMATE_LEN)*4);
+		flow_load4_sse(s, flow + (i + CLIMATE_LEN)*4);
+		__m128 in_w = w[VON_NEUMANN_NEIGHBOR_E];
+		__m128 in_e = e[VON_NEUMANN_NEIGHBOR_W];
+		__m128 in_n = n[VON_NEUMANN_NEIGHBOR_S];
+		__m128 in_s = s[VON_NEUMANN_NEIGHBOR_N];
+
+		__m128 outflow = _mm_add_ps(_mm_add_ps(_mm_add_ps(out[0], out[1]), out[2]), out[3]);
+		__m128 t = _mm_loadu_ps(c->inv_temp + i);
+		t = _mm_add_ps(t, in_n);
+		t = _mm_add_ps(t, in_w);
+		t = _mm_sub_ps(t, outflow);
+		t = _mm_add_ps(t, in_e);
+		t = _mm_add_ps(t, in_s);
+		_mm_storeu_ps(c->inv_temp + i, t);
+
+		__m128 u = _mm_sub_ps(_mm_add_ps(_mm_sub_ps(in_w, out[VON_NEUMANN_NEIGHBOR_W]),
+		                                 out[VON_NEUMANN_NEIGHBOR_E]), in_e);
+		__m128 v = _mm_sub_ps(_mm_add_ps(_mm_sub_ps(in_n, out[VON_NEUMANN_NEIGHBOR_N]),
+		                                 out[VON_NEUMANN_NEIGHBOR_S]), in_s);
+		u = _mm_mul_ps(half, u);
+		v = _mm_mul_ps(half, v);
+		_mm_storeu_ps(c->wind_velocity + 2*i + 0, _mm_unpacklo_ps(u, v));
+		_mm_storeu_ps(c->wind_velocity + 2*i + 4, _mm_unpackhi_ps(u, v));
 	}
+	equalize_temperature_flow_interior(c, i, end);
 }
 
+/* flow_load4_sse() of eight cells, the last four in the upper lanes */
+__attribute__((target("avx")))
+static inline void
+flow_load8_avx(__m256 v[4], const float *p)
+{
+	for (size_t k = 0; k < 4; ++ k) {
+		v[k] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 4*k)),
+		                            _mm_loadu_ps(p + 16 + 4*k), 1);
+	}
+	__m256 t0 = _mm256_unpacklo_ps(v[0], v[1]);
+	__m256 t1 = _mm256_unpackhi_ps(v[0], v[1]);
+	__m256 t2 = _mm256_unpacklo_ps(v[2], v[3]);
+	__m256 t3 = _mm256_unpackhi_ps(v[2], v[3]);
+	v[0] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	v[1] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	v[2] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	v[3] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+__attribute__((target("avx")))
+static void
+equalize_temperature_flow_interior_avx(struct climate *c, size_t i, size_t end)
+{
+	const float *flow = c->inv_temp_flow;
+	const __m256 half = _mm256_set1_ps(0.5f);
+	for (; i + 8 <= end; i += 8) {
+		__m256 out[4], w[4], e[4], n[4], s[4];
+		flow_load8_avx(out, flow + i*4);
+		flow_load8_avx(w, flow + (i - 1)*4);
+		flow_load8_avx(e, flow + (i + 1)*4);
+		flow_load8_avx(n, flow + (i - CLIMATE_LEN)*4);
+		flow_load8_avx(s, flow + (i + CLIMATE_LEN)*4);
+		__m256 in_w = w[VON_NEUMANN_NEIGHBOR_E];
+		__m256 in_e = e[VON_NEUMANN_NEIGHBOR_W];
+		__m256 in_n = n[VON_NEUMANN_NEIGHBOR_S];
+		__m256 in_s = s[VON_NEUMANN_NEIGHBOR_N];
+
+		__m256 outflow = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(out[0], out[1]), out[2]), out[3]);
+		__m256 t = _mm256_loadu_ps(c->inv_temp + i);
+		t = _mm256_add_ps(t, in_n);
+		t = _mm256_add_ps(t, in_w);
+		t = _mm256_sub_ps(t, outflow);
+		t = _mm256_add_ps(t, in_e);
+		t = _mm256_add_ps(t, in_s);
+		_mm256_storeu_ps(c->inv_temp + i, t);
+
+		__m256 u = _mm256_sub_ps(_mm256_add_ps(_mm256_sub_ps(in_w, out[VON_NEUMANN_NEIGHBOR_W]),
+		                                       out[VON_NEUMANN_NEIGHBOR_E]), in_e);
+		__m256 v = _mm256_sub_ps(_mm256_add_ps(_mm256_sub_ps(in_n, out[VON_NEUMANN_NEIGHBOR_N]),
+		                                       out[VON_NEUMANN_NEIGHBOR_S]), in_s);
+		u = _mm256_mul_ps(half, u);
+		v = _mm256_mul_ps(half, v);
+		__m256 lo = _mm256_unpacklo_ps(u, v);
+		__m256 hi = _mm256_unpackhi_ps(u, v);
+		_mm256_storeu_ps(c->wind_velocity + 2*i + 0, _mm256_permute2f128_ps(lo, hi, 0x20));
+		_mm256_storeu_ps(c->wind_velocity + 2*i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+	}
+	equalize_temperature_flow_interior_sse(c, i, end);
+}
+#endif /* CLIMATE_SIMD */
+
 static float
 latitude_temperature(float latitude)
 {
@@ -158,9 +418,9 @@ latitude_temperature(float latitude)
 }
 
 static void
-precipitation(struct climate *c)
+precipitation(struct climate *c, size_t y0, size_t y1)
 {
-	for (size_t y = 0; y < CLIMATE_LEN; ++ y)
+	for (size_t y = y0; y < y1; ++ y)
 	for (size_t x = 0; x < CLIMATE_LEN; ++ x) {
 		size_t i = y * CLIMATE_LEN + x;
 		/* Either evaporate over water or precipitate over land */
@@ -193,48 +453,20 @@ temperature_init(struct climate *c)
 		c->inv_temp_init[i] = 1 - temp;
 	}
 
-	const long long gkl = 16 * MAX(CLIMATE_LEN / 1024, 1);
-	const long long gksz = 2*gkl+1;
-	float gk[gksz];
-	GAUSSIANK(gk, gksz);
-	float *blur_line = xmalloc(CLIMATE_LEN * sizeof(*blur_line));
-
 	/* Blur temperature */
-	for (size_t y = 0; y < CLIMATE_LEN; ++ y) {
-		for (size_t x = 0; x < CLIMATE_LEN; ++ x) {
-			blur_line[x] = 0;
-			for (int g = 0; g < gksz; ++ g) {
-				size_t i = y * CLIMATE_LEN + wrapidx(x+g-gkl, CLIMATE_LEN);
-				blur_line[x] += gk[g] * c->inv_temp_init[i];
-			}
-		}
-		for (size_t x = 0; x < CLIMATE_LEN; ++ x)
-			c->inv_temp_init[y * CLIMATE_LEN + x] = blur_line[x];
-	}
-	for (size_t x = 0; x < CLIMATE_LEN; ++ x) {
-		for (size_t y = 0; y < CLIMATE_LEN; ++ y) {
-			blur_line[y] = 0;
-			for (int g = 0; g < gksz; ++ g) {
-				size_t i = wrapidx(y+g-gkl, CLIMATE_LEN) * CLIMATE_LEN + x;
-				blur_line[y] += gk[g] * c->inv_temp_init[i];
-			}
-		}
-		for (size_t y = 0; y < CLIMATE_LEN; ++ y)
-			c->inv_temp_init[y * CLIMATE_LEN + x] = blur_line[y];
-	}
+	blur_gaussian(c->inv_temp_init, CLIMATE_LEN, CLIMATE_LEN,
+	              16 * MAX(CLIMATE_LEN / 1024, 1), BLUR_EDGE_WRAP);
 
 	for (size_t i = 0; i < CLIMATE_LEN * CLIMATE_LEN; ++ i) {
 		c->inv_temp[i] = c->inv_temp_init[i];
 	}
-
-	free(blur_line);
 }
 
 static void
-temperature_update(struct climate *c)
+temperature_update(struct climate *c, size_t y0, size_t y1)
 {
 	/* Lose temperature at altitude, latitude */
-	for (size_t i = 0; i < CLIMATE_LEN * CLIMATE_LEN; ++ i) {
+	for (size_t i = y0 * CLIMATE_LEN; i < y1 * CLIMATE_LEN; ++ i) {
 		if (c->inv_temp_init[i] > c->inv_temp[i]) {
 			c->inv_temp[i] += (c->inv_temp_init[i] -
 			                   c->inv_temp[i]) * RATE_OF_TEMP_XFER;
@@ -1,13 +1,60 @@
 #include "hammer/worldgen/region.h"
+#include "hammer/blur.h"
+#include "hammer/hexagon.h"
 #include "hammer/math.h"
 #include "hammer/mem.h"
+#include "hammer/parallel.h"
 #include "hammer/worldgen/stream.h"
 #include "hammer/worldgen/tectonic.h"
 #include "hammer/vector.h"
-#include <float.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Region cells along each side of a rasterization tile */
+#define REGION_TILE_LEN 64
+/* Fixed point subdivisions of a region cell */
+#define REGION_SUBPIXEL 256
+
+/*
+ * A stream graph triangle placed in region space. Vertices are fixed point
+ * and wound such that edge functions are positive inside. The bounding box of
+ * cells covered is clipped to the region.
+ */
+struct region_tri {
+	long long x[3], y[3];
+	long left, top, right, bottom;
+	float height[3];
+	float water[3];
+	float max_lake;
+};
+
+struct region_raster {
+	struct region *r;
+	const struct region_tri *tris;
+	const size_t *bin_start;
+	const uint32_t *bins;
+	size_t tiles_len;
+};
 
 static void region_blit(struct region *,
                         const struct stream_graph *);
+static void region_place_tris(const struct region *,
+                              const struct stream_graph *,
+                              struct region_tri **);
+static void region_raster_tiles(void *, size_t t0, size_t t1);
+static void region_raster_tri(struct region *, const struct region_tri *,
+                              long left, long top, long right, long bottom);
+static inline void region_shade(struct region *, const struct region_tri *,
+                                size_t i, float w0, float w1, float w2);
+static inline float region_lerp_row(const float *row0, const float *row1,
+                                    float tz, size_t size, float x);
+static size_t region_column_bound(float x, float bound, size_t cols);
+static void region_lerp_columns(float *restrict out,
+                                const float *restrict row0,
+                                const float *restrict row1,
+                                float tz, size_t size, float x,
+                                size_t lo, size_t hi);
 
 void
 region_create(struct region *r,
@@ -43,8 +90,52 @@ region_erode(struct region *r)
 float
 region_stone_at(const struct region *r, float x, float z)
 {
-	/* XXX lerp */
-	return r->stone[(int)z * r->size + (int)x];
+	size_t z0 = (size_t)z;
+	size_t z1 = MIN(z0 + 1, r->size - 1);
+	return region_lerp_row(r->stone + z0 * r->size, r->stone + z1 * r->size,
+	                       z - z0, r->size, x);
+}
+
+void
+region_sample_columns(const struct region *reg, long r0, long q0,
+                      size_t rows, size_t cols, float *heights)
+{
+	for (size_t r = 0; r < rows; ++ r) {
+		float *out = heights + r * cols;
+
+		/*
+		 * Every block in an axial row lies at the same z, so the two
+		 * region rows we interpolate between are fixed per row, and x
+		 * steps by sqrt(3) from one column to the next.
+		 */
+		float x, z;
+		hex_axial_to_pixel(1, q0, r0 + (long)r, &x, &z);
+		if (z < 0 || z >= reg->size) {
+			for (size_t q = 0; q < cols; ++ q)
+				out[q] = -INFINITY;
+			continue;
+		}
+		size_t z0 = (size_t)z;
+		size_t z1 = MIN(z0 + 1, reg->size - 1);
+		const float *row0 = reg->stone + z0 * reg->size;
+		const float *row1 = reg->stone + z1 * reg->size;
+		float tz = z - z0;
+
+		/* Only columns [lo,hi) lie within the region */
+		size_t lo = region_column_bound(x, 0, cols);
+		size_t hi = MAX(lo, region_column_bound(x, reg->size, cols));
+		for (size_t q = 0; q < lo; ++ q)
+			out[q] = -INFINITY;
+		region_lerp_columns(out, row0, row1, tz, reg->size, x, lo, hi);
+		for (size_t q = hi; q < cols; ++ q)
+			out[q] = -INFINITY;
+	}
+}
+
+static long long
+floor_div(long long a, long long b)
+{
+	return a / b - (a % b < 0);
 }
 
 static void
@@ -53,12 +144,77 @@ region_blit(struct region *r,
 {
 	/*
 	 * Blit height information from stream graph onto region.
-	 * NOTE: This is *exactly* the same code we use to render the
+	 * NOTE: This started out as the same code we use to render the
 	 * composite image in appstate/planet_generation.c
+	 *
+	 * Every triangle overlapping the region is placed in fixed point
+	 * region space and binned into the tiles its bounding box covers.
+	 * Tiles never share a cell, so each is rasterized in parallel.
 	 */
-	size_t tri_count = vector_size(s->tris);
+	const size_t tiles_len = (r->size + REGION_TILE_LEN - 1) / REGION_TILE_LEN;
+	const size_t tile_count = tiles_len * tiles_len;
+	struct region_tri *tris = NULL;
+	region_place_tris(r, s, &tris);
+	size_t tri_count = vector_size(tris);
+
+	/* Bins are stored contiguously, each in triangle order */
+	size_t *bin_start = xcalloc(tile_count + 1, sizeof(*bin_start));
+	for (size_t ti = 0; ti < tri_count; ++ ti) {
+		const struct region_tri *t = tris + ti;
+		for (long y = t->top  / REGION_TILE_LEN; y <= t->bottom / REGION_TILE_LEN; ++ y)
+		for (long x = t->left / REGION_TILE_LEN; x <= t->right  / REGION_TILE_LEN; ++ x)
+			++ bin_start[y * tiles_len + x + 1];
+	}
+	for (size_t i = 0; i < tile_count; ++ i)
+		bin_start[i + 1] += bin_start[i];
+	uint32_t *bins = xmalloc(bin_start[tile_count] * sizeof(*bins));
+	size_t *bin_end = xmalloc(tile_count * sizeof(*bin_end));
+	memcpy(bin_end, bin_start, tile_count * sizeof(*bin_end));
 	for (size_t ti = 0; ti < tri_count; ++ ti) {
-		struct stream_tri *tri = &s->tris[ti];
+		const struct region_tri *t = tris + ti;
+		for (long y = t->top  / REGION_TILE_LEN; y <= t->bottom / REGION_TILE_LEN; ++ y)
+		for (long x = t->left / REGION_TILE_LEN; x <= t->right  / REGION_TILE_LEN; ++ x)
+			bins[bin_end[y * tiles_len + x] ++] = ti;
+	}
+	free(bin_end);
+
+	struct region_raster job = {
+		.r = r,
+		.tris = tris,
+		.bin_start = bin_start,
+		.bins = bins,
+		.tiles_len = tiles_len
+	};
+	parallel_for(tile_count, 1, region_raster_tiles, &job);
+	free(bins);
+	free(bin_start);
+	vector_free(&tris);
+
+	/* Gaussian blur */
+	blur_gaussian(r->stone, r->size, r->size, REGION_UPSCALE * 2,
+	              BLUR_EDGE_CLAMP);
+	blur_gaussian(r->water, r->size, r->size, REGION_UPSCALE * 2,
+	              BLUR_EDGE_CLAMP);
+}
+
+static void
+region_place_tris(const struct region *r,
+                  const struct stream_graph *s,
+                  struct region_tri **tris)
+{
+	/* Fixed point units per stream graph unit */
+	const long long unit = REGION_UPSCALE * REGION_SUBPIXEL;
+	const long long world = unit * s->size;
+	const long long region_wrap = REGION_UPSCALE * (long long)s->size;
+
+	/* Only triangles near the region */
+	uint32_t *nearby = NULL;
+	stream_graph_tris_in_rect(s, r->stream_coord_left, r->stream_coord_top,
+	                          r->stream_region_size, r->stream_region_size,
+	                          &nearby);
+	size_t nearby_count = vector_size(nearby);
+	for (size_t k = 0; k < nearby_count; ++ k) {
+		struct stream_tri *tri = &s->tris[nearby[k]];
 		struct stream_node n[3] = {
 			s->nodes[tri->a],
 			s->nodes[tri->b],
@@ -66,136 +222,224 @@ region_blit(struct region *r,
 		};
 
 		/*
-		 * Very basic triangle discard. We have two sets of
-		 * coordinates along each axis to handle wrapping. We know the
-		 * base coordinates are within the map, however the farther
-		 * extent may wrap. If none of the three points fall into
-		 * either the x or y bounds (picture this as a plus symbol
-		 * extending from the region to the extent of the map) then
-		 * the triangle cannot intercept the region. This is simpler
-		 * than performing triangle-AABB intersection upon all four
-		 * potentially wrapped bounding boxes.
+		 * Each node is rounded to fixed point exactly once, and
+		 * everything after is integer arithmetic, so triangles sharing
+		 * an edge agree on exactly where it is.
 		 */
-		{
-			float rl0 = r->stream_coord_left;
-			float rt0 = r->stream_coord_top;
-			float rr0 = r->stream_coord_left + r->size;
-			float rb0 = r->stream_coord_top + r->size;
-			float rl1 = rl0 - s->size;
-			float rr1 = rr0 - s->size;
-			float rt1 = rt0 - s->size;
-			float rb1 = rb0 - s->size;
-			for (size_t i = 0; i < 3; ++ i) {
-				if ((n[i].x >= rl0 && n[i].x <= rr0) ||
-				    (n[i].x >= rl1 && n[i].x <= rr1) ||
-				    (n[i].y >= rt0 && n[i].y <= rb0) ||
-				    (n[i].y >= rt1 && n[i].y <= rb1))
-				{
-					goto process_triangle;
-				}
-			}
+		long long x[3], y[3];
+		for (size_t i = 0; i < 3; ++ i) {
+			x[i] = llroundf(n[i].x * unit) - r->stream_coord_left * unit;
+			y[i] = llroundf(n[i].y * unit) - r->stream_coord_top  * unit;
 		}
-		continue;
-		process_triangle: ;
-
 
-		/* Determine lake height of triangle */
-		float max_lake = 0;
-		for (size_t i = 0; i < 3; ++ i)
-			max_lake = MAX(max_lake, s->trees[n[i].tree].pass_to_receiver);
 		/*
 		 * In order to draw triangles that straddle the map border we
 		 * need to project those positions either negative, or beyond
 		 * the bounds of the map before calculating the bounding box
-		 * of the triangle.
-		 *
-		 * Two points on a triangle should never be further away than
-		 * wrap_delta. If they are, reproject the third point by
-		 * adding or subtracting the size of the stream graph.
+		 * of the triangle. Like stream_graph_tri_nodes(), project the
+		 * second and third nodes to lie nearest the first.
 		 */
-		const float wrap_delta = 512;
-		#define NORMALIZE_NODE(N,A) do {                             \
-			float d1 = n[N].A - n[(N+1)%3].A;                    \
-			float d2 = n[N].A - n[(N+2)%3].A;                    \
-			if (fabsf(d1) > wrap_delta && fabsf(d2) > wrap_delta)\
-				n[N].A -= s->size * signf(d1);               \
-		} while (0)
-		NORMALIZE_NODE(0, x);
-		NORMALIZE_NODE(0, y);
-		NORMALIZE_NODE(1, x);
-		NORMALIZE_NODE(1, y);
-		NORMALIZE_NODE(2, x);
-		NORMALIZE_NODE(2, y);
-		#undef NORMALIZE_NODE
-		long left   = floorf(MIN(n[0].x, MIN(n[1].x, n[2].x)));
-		long right  =  ceilf(MAX(n[0].x, MAX(n[1].x, n[2].x)));
-		long top    = floorf(MIN(n[0].y, MIN(n[1].y, n[2].y)));
-		long bottom =  ceilf(MAX(n[0].y, MAX(n[1].y, n[2].y)));
-
-		/* "raw" coordinates may exceed map bounds */
-		float step = 1.0f / REGION_UPSCALE;
-		const size_t region_wrap = REGION_UPSCALE * s->size;
-		for (float ry = top; ry - bottom <= FLT_EPSILON; ry += step)
-		for (float rx = left; rx - right <= FLT_EPSILON; rx += step) {
-			long wx = wrapidx(REGION_UPSCALE * (rx - r->stream_coord_left), region_wrap);
-			long wy = wrapidx(REGION_UPSCALE * (ry - r->stream_coord_top), region_wrap);
-			if ((size_t)wx >= r->size || (size_t)wy >= r->size)
-				continue;
-
-			float w[3] = { 0, 0, 0 };
-			stream_node_barycentric_weights(&n[0], &n[1], &n[2], w, rx, ry);
-			if (w[0] < 0 || w[1] < 0 || w[2] < 0)
-				continue;
-			float elev = n[0].height * w[0] + n[1].height * w[1] + n[2].height * w[2];
-			float water = n[0].drainage / 100000.0f * w[0] +
-			              n[1].drainage / 100000.0f * w[1] +
-			              n[2].drainage / 100000.0f * w[2];
-			water = MIN(water, 0.1f);
-			if (elev < max_lake)
-				water = max_lake - elev;
-			if (elev < TECTONIC_CONTINENT_MASS)
-				water = TECTONIC_CONTINENT_MASS - elev;
-
-			size_t i = wy * r->size + wx;
-			r->sediment[i] = 3;
-			r->stone[i] = REGION_HEIGHT_SCALE * elev;
-			r->water[i] = REGION_HEIGHT_SCALE * water;
+		for (size_t i = 1; i < 3; ++ i) {
+			if (x[i] - x[0] > world / 2)
+				x[i] -= world;
+			else if (x[i] - x[0] < -world / 2)
+				x[i] += world;
+			if (y[i] - y[0] > world / 2)
+				y[i] -= world;
+			else if (y[i] - y[0] < -world / 2)
+				y[i] += world;
 		}
-	}
 
-	float *blurring[2] = { r->stone, r->water };
+		/* Wind every triangle the same way, discarding degenerates */
+		long long area = (x[1] - x[0]) * (y[2] - y[0]) -
+		                 (y[1] - y[0]) * (x[2] - x[0]);
+		if (area == 0)
+			continue;
+		size_t o[3] = { 0, area > 0 ? 1 : 2, area > 0 ? 2 : 1 };
 
-	/* Gaussian blur */
-	const long long gkl = REGION_UPSCALE * 2;
-	const long long gksz = 2*gkl+1;
-	float gk[gksz];
-	GAUSSIANK(gk, gksz);
-	float *blur_line = xmalloc(r->size * sizeof(*blur_line));
-
-	for (size_t l = 0; l < 2; ++ l) {
-		for (size_t y = 0; y < r->size; ++ y) {
-			for (size_t x = 0; x < r->size; ++ x) {
-				blur_line[x] = 0;
-				for (int g = 0; g < gksz; ++ g) {
-					size_t i = y * r->size + MIN(x+g-gkl, r->size-1);
-					blur_line[x] += gk[g] * blurring[l][i];
-				}
+		struct region_tri t;
+		t.max_lake = 0;
+		for (size_t i = 0; i < 3; ++ i) {
+			const struct stream_node *node = n + o[i];
+			t.height[i] = node->height;
+			t.water[i] = node->drainage / 100000.0f;
+			t.max_lake = MAX(t.max_lake,
+			                 s->trees[node->tree].pass_to_receiver);
+		}
+
+		/* Region cells (which sit on fixed point multiples) covered */
+		long long left   = -floor_div(-MIN(x[0], MIN(x[1], x[2])), REGION_SUBPIXEL);
+		long long right  =  floor_div( MAX(x[0], MAX(x[1], x[2])), REGION_SUBPIXEL);
+		long long top    = -floor_div(-MIN(y[0], MIN(y[1], y[2])), REGION_SUBPIXEL);
+		long long bottom =  floor_div( MAX(y[0], MAX(y[1], y[2])), REGION_SUBPIXEL);
+
+		/*
+		 * Place the triangle at every multiple of the stream graph
+		 * size which overlaps the region. This is almost always once,
+		 * or not at all.
+		 */
+		for (long long ky = -floor_div(bottom, region_wrap);
+		     top + ky * region_wrap < (long long)r->size; ++ ky)
+		for (long long kx = -floor_div(right, region_wrap);
+		     left + kx * region_wrap < (long long)r->size; ++ kx)
+		{
+			for (size_t i = 0; i < 3; ++ i) {
+				t.x[i] = x[o[i]] + kx * region_wrap * REGION_SUBPIXEL;
+				t.y[i] = y[o[i]] + ky * region_wrap * REGION_SUBPIXEL;
 			}
-			for (size_t x = 0; x < r->size; ++ x)
-				blurring[l][y * r->size + x] = blur_line[x];
+			t.left   = MAX(left   + kx * region_wrap, 0);
+			t.top    = MAX(top    + ky * region_wrap, 0);
+			t.right  = MIN(right  + kx * region_wrap, (long long)r->size - 1);
+			t.bottom = MIN(bottom + ky * region_wrap, (long long)r->size - 1);
+			if (t.left <= t.right && t.top <= t.bottom)
+				vector_push(tris, t);
+		}
+	}
+	vector_free(&nearby);
+}
+
+static void
+region_raster_tiles(void *arg, size_t t0, size_t t1)
+{
+	const struct region_raster *job = arg;
+	for (size_t ti = t0; ti < t1; ++ ti) {
+		long left = ti % job->tiles_len * REGION_TILE_LEN;
+		long top  = ti / job->tiles_len * REGION_TILE_LEN;
+		long right  = MIN(left + REGION_TILE_LEN, (long)job->r->size) - 1;
+		long bottom = MIN(top  + REGION_TILE_LEN, (long)job->r->size) - 1;
+		/* Drawn in triangle order, exactly as if drawn serially */
+		for (size_t b = job->bin_start[ti]; b < job->bin_start[ti+1]; ++ b) {
+			const struct region_tri *t = job->tris + job->bins[b];
+			region_raster_tri(job->r, t,
+			                  MAX(left, t->left), MAX(top, t->top),
+			                  MIN(right, t->right), MIN(bottom, t->bottom));
 		}
-		for (size_t x = 0; x < r->size; ++ x) {
-			for (size_t y = 0; y < r->size; ++ y) {
-				blur_line[y] = 0;
-				for (int g = 0; g < gksz; ++ g) {
-					size_t i = MIN(y+g-gkl, r->size-1) * r->size + x;
-					blur_line[y] += gk[g] * blurring[l][i];
-				}
+	}
+}
+
+static void
+region_raster_tri(struct region *r, const struct region_tri *t,
+                  long left, long top, long right, long bottom)
+{
+	/*
+	 * Edge function of the edge opposite each vertex, from a to b:
+	 *   (bx - ax) * (y - ay) - (by - ay) * (x - ax)
+	 * This is twice the area of the triangle between that edge and
+	 * sample (x,y), positive inside the triangle, so divided by the area
+	 * of the whole triangle gives us the barycentric weight of each
+	 * vertex. We only need to evaluate these at the top left sample, after
+	 * which each step along a row or column is a single addition.
+	 */
+	long long e[3], step_x[3], step_y[3], bias[3];
+	for (size_t i = 0; i < 3; ++ i) {
+		size_t a = (i + 1) % 3;
+		size_t b = (i + 2) % 3;
+		long long dx = t->x[b] - t->x[a];
+		long long dy = t->y[b] - t->y[a];
+		e[i] = dx * (top  * REGION_SUBPIXEL - t->y[a]) -
+		       dy * (left * REGION_SUBPIXEL - t->x[a]);
+		step_x[i] = -dy * REGION_SUBPIXEL;
+		step_y[i] =  dx * REGION_SUBPIXEL;
+		/*
+		 * Samples lying exactly upon an edge belong to only one of the
+		 * two triangles sharing it, which traverse it in opposite
+		 * directions.
+		 */
+		bias[i] = (dy < 0 || (dy == 0 && dx > 0)) ? 0 : -1;
+	}
+	float inv_area = 1.0f / ((t->x[1] - t->x[0]) * (t->y[2] - t->y[0]) -
+	                         (t->y[1] - t->y[0]) * (t->x[2] - t->x[0]));
+
+	for (long y = top; y <= bottom; ++ y) {
+		long long w[3] = { e[0], e[1], e[2] };
+		for (long x = left; x <= right; ++ x) {
+			if (w[0] + bias[0] >= 0 &&
+			    w[1] + bias[1] >= 0 &&
+			    w[2] + bias[2] >= 0)
+			{
+				region_shade(r, t, y * r->size + x,
+				             w[0] * inv_area,
+				             w[1] * inv_area,
+				             w[2] * inv_area);
 			}
-			for (size_t y = 0; y < r->size; ++ y)
-				blurring[l][y * r->size + x] = blur_line[y];
+			w[0] += step_x[0];
+			w[1] += step_x[1];
+			w[2] += step_x[2];
 		}
+		e[0] += step_y[0];
+		e[1] += step_y[1];
+		e[2] += step_y[2];
+	}
+}
+
+static inline void
+region_shade(struct region *r, const struct region_tri *t, size_t i,
+             float w0, float w1, float w2)
+{
+	float elev = t->height[0] * w0 + t->height[1] * w1 + t->height[2] * w2;
+	float water = t->water[0] * w0 + t->water[1] * w1 + t->water[2] * w2;
+	water = MIN(water, 0.1f);
+	if (elev < t->max_lake)
+		water = t->max_lake - elev;
+	if (elev < TECTONIC_CONTINENT_MASS)
+		water = TECTONIC_CONTINENT_MASS - elev;
+
+	r->sediment[i] = 3;
+	r->stone[i] = REGION_HEIGHT_SCALE * elev;
+	r->water[i] = REGION_HEIGHT_SCALE * water;
+}
+
+/*
+ * Returns the first of cols columns, starting at x and stepping by sqrt(3),
+ * at or beyond bound. The estimate is corrected using the same expression
+ * region_lerp_columns() uses, so the two never disagree by rounding.
+ */
+static size_t
+region_column_bound(float x, float bound, size_t cols)
+{
+	float est = ceilf((bound - x) / HEX_SQRT3);
+	size_t q = est <= 0 ? 0 : est >= cols ? cols : (size_t)est;
+	while (q > 0 && x + HEX_SQRT3 * (q - 1) >= bound)
+		-- q;
+	while (q < cols && x + HEX_SQRT3 * q < bound)
+		++ q;
+	return q;
+}
+
+/*
+ * region_lerp_row() at columns [lo,hi), stepping from x by sqrt(3), which
+ * must all lie within the row. There's no control flow and indices are
+ * ints, so the compiler vectorizes this with gathers.
+ */
+static void
+region_lerp_columns(float *restrict out,
+                    const float *restrict row0, const float *restrict row1,
+                    float tz, size_t size, float x, size_t lo, size_t hi)
+{
+	const int last = (int)size - 1;
+	for (int q = (int)lo; q < (int)hi; ++ q) {
+		float xq = x + HEX_SQRT3 * q;
+		int x0 = (int)xq;
+		int x1 = MIN(x0 + 1, last);
+		float tx = xq - x0;
+		float top    = row0[x0] + (row0[x1] - row0[x0]) * tx;
+		float bottom = row1[x0] + (row1[x1] - row1[x0]) * tx;
+		out[q] = top + (bottom - top) * tz;
 	}
+}
 
-	free(blur_line);
+/*
+ * Bilinear interpolation at x between row0 and row1, tz of the way to row1.
+ * x must lie within [0,size), the last column is held beyond the edge.
+ */
+static inline float
+region_lerp_row(const float *row0, const float *row1, float tz, size_t size,
+                float x)
+{
+	size_t x0 = (size_t)x;
+	size_t x1 = MIN(x0 + 1, size - 1);
+	float tx = x - x0;
+	float top    = row0[x0] + (row0[x1] - row0[x0]) * tx;
+	float bottom = row1[x0] + (row1[x1] - row1[x0]) * tx;
+	return top + (bottom - top) * tz;
 }
@@ -2,14 +2,15 @@
 #include "hammer/error.h"
 #include "hammer/math.h"
 #include "hammer/mem.h"
+#include "hammer/parallel.h"
 #include "hammer/poisson.h"
-#include "hammer/ring.h"
 #include "hammer/vector.h"
 #include "hammer/worldgen/climate.h"
 #include "hammer/worldgen/tectonic.h"
 #include <delaunay/delaunay.h>
 #include <delaunay/helper.h>
 #include <float.h>
+#include <stdlib.h>
 #include <string.h>
 
 /*
@@ -28,11 +29,78 @@
 
 #define NO_NODE ((uint32_t)-1)
 
-static void assign_tree(struct stream_graph *g, uint32_t nid, uint32_t **upstream);
+/* Width of the band of points copied across the border to triangulate */
+#define DELAUNAY_BAND (4 * POISSON_RADIUS)
+
+/* Initial capacity of the edge set per node, about three edges per node */
+#define EDGE_SET_SCALE 8
+
+/*
+ * Resolution of the Hilbert curve nodes are sorted along, about one point
+ * per cell. Limited so curve indices fit in 32 bits.
+ */
+#define HILBERT_CELL POISSON_RADIUS
+#define HILBERT_MAX_LEN (1u << 16)
+
+/* Nodes and trees per band of the parallel update stages */
+#define STREAM_NODE_GRAIN 4096
+#define STREAM_TREE_GRAIN 16
+
+/*
+ * State shared by the parallel stages of stream_graph_update. The donors of
+ * each node are stored contiguously: node i owns [donor_start[i],
+ * donor_start[i+1]).
+ */
+struct stream_pass {
+	struct stream_graph *g;
+	float               *talus_xfer;
+	uint32_t            *donor_start;
+	uint32_t            *donors;
+};
+
+/*
+ * The lowest pass between two trees, where the pass over an edge is the
+ * height of its higher node. Every lake is treated as the same tree,
+ * numbered tree_count, since water never flows from a lake.
+ */
+struct lake_link {
+	uint32_t t0;
+	uint32_t t1;
+	uint32_t a, b; /* nodes either side of the pass, a < b */
+	float    pass;
+};
+
+/* Initial capacity of the lake link table, per tree */
+#define LAKE_LINK_TABLE_SCALE 8
+
 static uint32_t next_tree(struct stream_graph *g);
 static void flow_drainage_area(struct stream_graph *g, uint32_t ni);
 static void stream_power(struct stream_graph *g, uint32_t ni);
-static void add_to_depth_queue(struct stream_graph *g, uint32_t **depth_queue, uint32_t ni);
+static void reset_nodes(void *, size_t n0, size_t n1);
+static void select_receivers(void *, size_t n0, size_t n1);
+static void talus_outflow(void *, size_t n0, size_t n1);
+static void talus_inflow(void *, size_t n0, size_t n1);
+static void find_donors(const struct stream_graph *g, struct stream_pass *pass);
+static void label_trees(void *, size_t t0, size_t t1);
+static void erode_basins(void *, size_t t0, size_t t1);
+static void resolve_lakes(struct stream_graph *g);
+static uint32_t *lake_link_slot(uint32_t *table, size_t mask, const struct lake_link *links, uint32_t t0, uint32_t t1);
+static int cmp_lake_link(const void *, const void *);
+static uint32_t find_set(uint32_t *parent, uint32_t i);
+static int edge_set_insert(uint64_t *set, size_t mask, uint32_t a, uint32_t b);
+static void build_adjacency(struct stream_graph *g);
+static void sort_hilbert(float *pt, size_t npt, unsigned long size);
+static uint32_t hilbert_index(uint32_t len, uint32_t x, uint32_t y);
+static int cmp_uint64(const void *, const void *);
+static int cmp_stream_tri(const void *, const void *);
+static void build_index(struct stream_graph *g);
+static long index_coord(const struct stream_graph *g, float x);
+static void index_span(const struct stream_graph *g, float lo, float hi, long span[2]);
+static void index_tri_span(const struct stream_graph *g, uint32_t ti, long xs[2], long ys[2]);
+static size_t index_cell(const struct stream_graph *g, long x, long y);
+static float nearest_image(float d, float size);
+static void nearest_insert(uint32_t *nodes, float *dist, size_t *found, size_t k, uint32_t ni, float d);
+static int cmp_uint32(const void *, const void *);
 
 void
 stream_graph_create(struct stream_graph *g,
@@ -50,38 +118,45 @@ stream_graph_create(struct stream_graph *g,
 		xpanic("Number of points exceeds uint32_t");
 
 	/*
-	 * This is a super crude way of tiling a Delaunay triangulation:
-	 * transform the domain 9 times around center. I'm pretty confident
-	 * this doesn't even work, but it's sure better than no triangulation
-	 * about the hull. I don't even know how we would go about doing this
-	 * properly. It would involve a projection onto a sphere or a toroid.
-	 * Some domain where we would be left with a single polygonal gap.
-	 * Fuck that math.
+	 * Points come out of poisson() in no useful order. Nodes close
+	 * together are often visited together, so keep them close in memory.
+	 * Everything else is created from the points so inherits this order.
+	 */
+	sort_hilbert(pt, npt, size);
+
+	/*
+	 * To triangulate the torus, every point within DELAUNAY_BAND of the
+	 * border is copied across it, into whichever of our 8 Moore neighbors
+	 * it lands beside the center domain. Every triangle touching the
+	 * center domain is then triangulated exactly as it would be upon the
+	 * torus: Poisson disk sampling leaves no empty circle of radius over
+	 * twice POISSON_RADIUS, so no circumcircle reaches beyond the band.
 	 */
-	uint32_t nwrapped = npt * 9;
-	float *wrapped  = xmalloc(nwrapped * 2 * sizeof(*wrapped));
-	/* Our center points are [0,npt) */
-	memcpy(wrapped, pt, npt * 2 * sizeof(float));
-	/* And our 8 Moore neighbors, in no particular order */
-	float fsize = size;
-	float neighbor_offsets[8][2] = {
-		{ -fsize, -fsize },
-		{ -fsize,      0 },
-		{ -fsize, +fsize },
-
-		{      0, -fsize },
-		{      0, +fsize },
-
-		{ +fsize, -fsize },
-		{ +fsize,      0 },
-		{ +fsize, +fsize },
-	};
-	for (uint32_t n = 0; n < 8; ++ n)
+	float *wrapped = NULL;  /* vector, center points are [0,npt) */
+	uint32_t *orig = NULL;  /* vector, index of point each copies */
 	for (uint32_t i = 0; i < npt; ++ i) {
-		float *off = neighbor_offsets[n];
-		wrapped[((n+1) * npt + i)*2+0] = pt[i*2+0] + off[0];
-		wrapped[((n+1) * npt + i)*2+1] = pt[i*2+1] + off[1];
+		vector_push(&wrapped, pt[i*2+0]);
+		vector_push(&wrapped, pt[i*2+1]);
+		vector_push(&orig, i);
 	}
+	for (int oy = -1; oy <= 1; ++ oy)
+	for (int ox = -1; ox <= 1; ++ ox) {
+		if (ox == 0 && oy == 0)
+			continue;
+		for (uint32_t i = 0; i < npt; ++ i) {
+			float x = pt[i*2+0] + ox * (float)size;
+			float y = pt[i*2+1] + oy * (float)size;
+			if (x < -DELAUNAY_BAND || x >= size + DELAUNAY_BAND ||
+			    y < -DELAUNAY_BAND || y >= size + DELAUNAY_BAND)
+			{
+				continue;
+			}
+			vector_push(&wrapped, x);
+			vector_push(&wrapped, y);
+			vector_push(&orig, i);
+		}
+	}
+	uint32_t nwrapped = vector_size(orig);
 
 	/* Triangulate distribution */
 	delaunay = xcalloc(DELAUNAY_SZ(nwrapped), sizeof(*delaunay));
@@ -111,42 +186,55 @@ stream_graph_create(struct stream_graph *g,
 	}
 
 	/*
-	 * Create unique stream edges. We're going from half-edges (arcs) to
-	 * bi-directional edges here because the direction of flow between two
-	 * nodes may change and this is just easier. To reconcile half-edges
-	 * only create edges where the source point ID is less than the
-	 * destination point ID.
+	 * Create unique stream edges and triangles. We're going from
+	 * half-edges (arcs) to bi-directional edges here because the
+	 * direction of flow between two nodes may change and this is just
+	 * easier.
+	 *
+	 * A triangle straddling the border is triangulated up to three times,
+	 * once about each of its copied points. Only keep the copy whose
+	 * lowest indexed point lies within the center domain. Each edge is
+	 * still shared by two triangles so we only keep the first.
 	 */
 	uint32_t *triverts =  DELAUNAY_TRIVERTS(delaunay, nwrapped);
 	uint32_t ntris     = *DELAUNAY_NTRIVERT(delaunay, nwrapped) / 3;
+	size_t edge_set_mask = 1;
+	while (edge_set_mask < (size_t)EDGE_SET_SCALE * npt)
+		edge_set_mask <<= 1;
+	uint64_t *edge_set = xcalloc(edge_set_mask, sizeof(*edge_set));
+	-- edge_set_mask;
 	uint32_t e[3];
 	for (uint32_t t = 0; t < ntris; ++ t) {
 		tri_edges(t, e);
-		uint32_t a = triverts[e[0]];
-		uint32_t b = triverts[e[1]];
-		uint32_t c = triverts[e[2]];
-		/* Discard edges completely out of center domain */
-		if (a >= npt && b >= npt && c >= npt)
+		uint32_t v[3] = { triverts[e[0]], triverts[e[1]], triverts[e[2]] };
+		uint32_t o[3] = { orig[v[0]], orig[v[1]], orig[v[2]] };
+		size_t lowest = o[1] < o[0] ? 1 : 0;
+		lowest = o[2] < o[lowest] ? 2 : lowest;
+		if (v[lowest] >= npt)
 			continue;
-		/*
-		 * Wrap back to center domain from our Moore neighborhood,
-		 * mathematically inept travesty BEFORE culling half-edges.
-		 */
-		a %= npt;
-		b %= npt;
-		c %= npt;
-		if (a < b)
-			vector_push(&g->edges, (struct stream_edge) { a, b });
-		if (b < c)
-			vector_push(&g->edges, (struct stream_edge) { b, c });
-		if (c < a)
-			vector_push(&g->edges, (struct stream_edge) { c, a });
-		vector_push(&g->tris, (struct stream_tri) { a, b, c });
+		for (size_t i = 0; i < 3; ++ i) {
+			uint32_t a = o[i];
+			uint32_t b = o[(i+1)%3];
+			if (a == b)
+				continue;
+			if (edge_set_insert(edge_set, edge_set_mask, MIN(a, b), MAX(a, b)))
+				vector_push(&g->edges, (struct stream_edge) { MIN(a, b), MAX(a, b) });
+		}
+		vector_push(&g->tris, (struct stream_tri) { o[0], o[1], o[2] });
 	}
 
+	free(edge_set);
+	vector_free(&orig);
+	vector_free(&wrapped);
 	free(delaunay);
-	free(wrapped);
 	free(pt);
+
+	/* Triangles follow their lowest node along the curve too */
+	if (vector_size(g->tris))
+		qsort(g->tris, vector_size(g->tris), sizeof(*g->tris), cmp_stream_tri);
+
+	build_adjacency(g);
+	build_index(g);
 }
 
 void
@@ -156,10 +244,13 @@ stream_graph_destroy(struct stream_graph *g)
 	free(g->arcs);
 	vector_free(&g->edges);
 	vector_free(&g->tris);
-	size_t tree_count = vector_size(g->trees);
-	for (size_t t = 0; t < tree_count; ++ t)
-		vector_free(&g->trees[t].border_edges);
 	vector_free(&g->trees);
+	free(g->adjacency_start);
+	free(g->adjacency);
+	free(g->index.node_start);
+	free(g->index.nodes);
+	free(g->index.tri_start);
+	free(g->index.tris);
 }
 
 void
@@ -168,53 +259,12 @@ stream_graph_update(struct stream_graph *g)
 	++ g->generation;
 
 	/* Delete old trees */
-	{
-		size_t tree_count = vector_size(g->trees);
-		for (size_t t = 0; t < tree_count; ++ t)
-			vector_free(&g->trees[t].border_edges);
-		vector_clear(&g->trees);
-	}
-	for (uint32_t i = 0; i < g->node_count; ++ i) {
-		g->nodes[i].tree = NO_NODE;
-		g->nodes[i].drainage = 0;
-		g->nodes[i].unwound = 0;
-		g->arcs[i].receiver = NO_NODE;
-	}
-
-	/* Generate stream arcs */
-	uint32_t edge_count = vector_size(g->edges);
-	/* TODO: Easily parallel. Gains would be worth it */
-	for (uint32_t ei = 0; ei < edge_count; ++ ei) {
-		struct stream_edge *e = &g->edges[ei];
-		uint32_t src;
-		uint32_t dst;
-		float delta = g->nodes[e->a].height - g->nodes[e->b].height;
-		/* Do not use FLT_EPSILON; results in many lakes */
-		if (delta == 0)
-			continue;
-
-		if (delta > 0) {
-			src = e->a;
-			dst = e->b;
-		} else {
-			src = e->b;
-			dst = e->a;
-		}
+	vector_clear(&g->trees);
+	struct stream_pass pass = { .g = g };
 
-		/*
-		 * If this node has no receiver, assign dst as receiver.
-		 * Otherwise, determine which potential receiver is lower and
-		 * choose that receiver
-		 */
-		if (g->arcs[src].receiver == NO_NODE) {
-			g->arcs[src].receiver = dst;
-			continue;
-		}
-		struct stream_node *dstn = &g->nodes[dst];
-		struct stream_node *rcvn = &g->nodes[g->arcs[src].receiver];
-		if (rcvn->height > dstn->height)
-			g->arcs[src].receiver = dst;
-	}
+	/* Generate stream arcs, each node flowing to its lowest neighbor */
+	parallel_for(g->node_count, STREAM_NODE_GRAIN, reset_nodes, &pass);
+	parallel_for(g->node_count, STREAM_NODE_GRAIN, select_receivers, &pass);
 
 	/* Identify roots */
 	for (size_t ni = 0; ni < g->node_count; ++ ni) {
@@ -224,159 +274,497 @@ stream_graph_update(struct stream_graph *g)
 			n->tree = t;
 			int is_lake = n->height < TECTONIC_CONTINENT_MASS;
 			g->trees[t] = (struct stream_tree) {
-				.border_edges = NULL,
 				.lake_receiver = NO_NODE,
 				.node_receiver = NO_NODE,
 				.root = ni,
 				.pass_to_receiver = is_lake ? 0 : FLT_MAX,
-				.in_queue = 0,
 				.is_lake = is_lake
 			};
 		}
 	}
 
-	uint32_t *upstream = NULL;
-	for (size_t ni = 0; ni < g->node_count; ++ ni) {
-		if (g->arcs[ni].receiver != NO_NODE) {
-			assign_tree(g, ni, &upstream);
-		}
-	}
-	vector_free(&upstream);
-
-	/* Travel down to root to determine or create tree, identify lakes */
-	uint32_t *border_trees = NULL; /* ring buffer */
+	/* Every node upstream of a root belongs to its tree */
 	uint32_t tree_count = vector_size(g->trees);
+	find_donors(g, &pass);
+	parallel_for(tree_count, STREAM_TREE_GRAIN, label_trees, &pass);
+
+	/* Route every tree which isn't a lake to a lake over its lowest pass */
+	resolve_lakes(g);
+
+	/* Create arcs from passes */
 	for (uint32_t ti = 0; ti < tree_count; ++ ti) {
 		struct stream_tree *t = &g->trees[ti];
-		if (t->is_lake)
-			ring_push(&border_trees, ti);
+		if (t->node_receiver != NO_NODE)
+			g->arcs[t->root].receiver = t->node_receiver;
 	}
 
-	/* Assign edges to trees */
-	for (uint32_t ei = 0; ei < edge_count; ++ ei) {
-		struct stream_edge *e = &g->edges[ei];
-		struct stream_node *a = &g->nodes[e->a];
-		struct stream_node *b = &g->nodes[e->b];
-		if (a->tree == b->tree)
+	/* Arcs from passes join trees into basins draining to a single root */
+	free(pass.donor_start);
+	free(pass.donors);
+	find_donors(g, &pass);
+
+	/*
+	 * Calculate slope and perform thermal erosion. Every node first works
+	 * out how much slides to its receiver, then gathers what slides into
+	 * it from its donors, so both passes only write to their own node.
+	 */
+	pass.talus_xfer = xmalloc(g->node_count * sizeof(*pass.talus_xfer));
+	parallel_for(g->node_count, STREAM_NODE_GRAIN, talus_outflow, &pass);
+	parallel_for(g->node_count, STREAM_NODE_GRAIN, talus_inflow, &pass);
+	free(pass.talus_xfer);
+
+	/*
+	 * Drainage and erosion only flow along arcs, so each basin can be
+	 * solved independently.
+	 */
+	parallel_for(tree_count, STREAM_TREE_GRAIN, erode_basins, &pass);
+	free(pass.donor_start);
+	free(pass.donors);
+}
+
+uint32_t
+stream_graph_locate(const struct stream_graph *g,
+                    float x, float y, float w[3])
+{
+	const struct stream_index *ix = &g->index;
+	size_t c = index_cell(g, index_coord(g, x), index_coord(g, y));
+	for (uint32_t i = ix->tri_start[c]; i < ix->tri_start[c+1]; ++ i) {
+		uint32_t ti = ix->tris[i];
+		struct stream_node n[3];
+		stream_graph_tri_nodes(g, ti, n);
+		/* Query the image of (x,y) nearest this triangle */
+		float qx = n[0].x + nearest_image(x - n[0].x, g->size);
+		float qy = n[0].y + nearest_image(y - n[0].y, g->size);
+		float tw[3];
+		stream_node_barycentric_weights(&n[0], &n[1], &n[2], tw, qx, qy);
+		if (tw[0] < 0 || tw[1] < 0 || tw[2] < 0)
 			continue;
-		struct stream_tree *at = &g->trees[a->tree];
-		struct stream_tree *bt = &g->trees[b->tree];
-		/* Don't flow from lakes */
-		if (!bt->is_lake)
-			vector_push(&at->border_edges, ei);
-		if (!at->is_lake)
-			vector_push(&bt->border_edges, ei);
-	}
-
-	while (ring_size(border_trees)) {
-		uint32_t li = *ring_head(border_trees);
-		ring_pop(&border_trees);
-		struct stream_tree *lake_tree = &g->trees[li];
-		lake_tree->in_queue = 0; /* Mark as eligible for optimization */
-		size_t border_count = vector_size(lake_tree->border_edges);
-		for (uint32_t ei = 0; ei < border_count; ++ ei) {
-			struct stream_edge *e = &g->edges[lake_tree->border_edges[ei]];
-			uint32_t lake_nid = e->a;
-			uint32_t othr_nid = e->b;
-			struct stream_node *lake_node = &g->nodes[lake_nid];
-			struct stream_node *othr_node = &g->nodes[othr_nid];
-			/* Swap if necessary */
-			if (othr_node->tree == li) {
-				struct stream_node *tmpn = lake_node;
-				lake_node = othr_node;
-				othr_node = tmpn;
-				uint32_t tmpnid = lake_nid;
-				lake_nid = othr_nid;
-				othr_nid = tmpnid;
+		if (w)
+			memcpy(w, tw, sizeof(tw));
+		return ti;
+	}
+	return STREAM_NO_TRI;
+}
+
+size_t
+stream_graph_nearest(const struct stream_graph *g,
+                     float x, float y,
+                     size_t k, uint32_t *nodes)
+{
+	const struct stream_index *ix = &g->index;
+	k = MIN(k, g->node_count);
+	if (k == 0)
+		return 0;
+	float *dist = xmalloc(k * sizeof(*dist));
+	size_t found = 0;
+	long cx = index_coord(g, x);
+	long cy = index_coord(g, y);
+	const float cell_size = g->size / (float)ix->len;
+
+	/*
+	 * Search rings of cells outward from the query. Any node we haven't
+	 * seen after searching ring r lies at least r cells away.
+	 */
+	for (long r = 0; ; ++ r) {
+		if (2 * r + 1 > (long)ix->len) {
+			/* Rings have wrapped around, just check everything */
+			found = 0;
+			for (uint32_t ni = 0; ni < g->node_count; ++ ni) {
+				float dx = nearest_image(g->nodes[ni].x - x, g->size);
+				float dy = nearest_image(g->nodes[ni].y - y, g->size);
+				nearest_insert(nodes, dist, &found, k, ni, dx*dx + dy*dy);
 			}
-			/* Determine whether other flows into this lake */
-			struct stream_tree *n = &g->trees[othr_node->tree];
-			float pass = MAX(lake_tree->pass_to_receiver,
-			                 MAX(lake_node->height, othr_node->height));
-			if (pass < n->pass_to_receiver) {
-				n->pass_to_receiver = pass;
-				n->lake_receiver = li;
-				n->node_receiver = lake_nid;
-				if (!n->in_queue) {
-					n->in_queue = 1;
-					ring_push(&border_trees, othr_node->tree);
-				}
+			break;
+		}
+		for (long dy = -r; dy <= r; ++ dy)
+		for (long dx = -r; dx <= r; dx += (dy == -r || dy == r) ? 1 : 2 * r) {
+			size_t c = index_cell(g, cx + dx, cy + dy);
+			for (uint32_t i = ix->node_start[c]; i < ix->node_start[c+1]; ++ i) {
+				uint32_t ni = ix->nodes[i];
+				float ndx = nearest_image(g->nodes[ni].x - x, g->size);
+				float ndy = nearest_image(g->nodes[ni].y - y, g->size);
+				nearest_insert(nodes, dist, &found, k, ni, ndx*ndx + ndy*ndy);
 			}
 		}
-		vector_free(&lake_tree->border_edges);
+		float reach = r * cell_size;
+		if (found == k && dist[k-1] <= reach * reach)
+			break;
 	}
+	free(dist);
+	return found;
+}
 
-	ring_free(&border_trees);
+void
+stream_graph_tris_in_rect(const struct stream_graph *g,
+                          float left, float top,
+                          float width, float height,
+                          uint32_t **tris)
+{
+	const struct stream_index *ix = &g->index;
+	size_t first = vector_size(*tris);
+	long xs[2], ys[2];
+	index_span(g, left, left + width, xs);
+	index_span(g, top, top + height, ys);
+	for (long y = ys[0]; y <= ys[1]; ++ y)
+	for (long x = xs[0]; x <= xs[1]; ++ x) {
+		size_t c = index_cell(g, x, y);
+		for (uint32_t i = ix->tri_start[c]; i < ix->tri_start[c+1]; ++ i)
+			vector_push(tris, ix->tris[i]);
+	}
 
-	/* Create arcs from passes */
-	for (uint32_t ti = 0; ti < tree_count; ++ ti) {
-		struct stream_tree *t = &g->trees[ti];
-		if (t->node_receiver != NO_NODE)
-			g->arcs[t->root].receiver = t->node_receiver;
+	/* Triangles spanning several cells were pushed more than once */
+	size_t count = vector_size(*tris) - first;
+	if (count == 0)
+		return;
+	uint32_t *t = *tris + first;
+	qsort(t, count, sizeof(*t), cmp_uint32);
+	size_t unique = 1;
+	for (size_t i = 1; i < count; ++ i) {
+		if (t[i] != t[unique-1])
+			t[unique ++] = t[i];
+	}
+	while (count -- > unique)
+		vector_pop(tris);
+}
+
+void
+stream_graph_tri_nodes(const struct stream_graph *g, uint32_t ti,
+                       struct stream_node n[3])
+{
+	const struct stream_tri *t = &g->tris[ti];
+	n[0] = g->nodes[t->a];
+	n[1] = g->nodes[t->b];
+	n[2] = g->nodes[t->c];
+	for (size_t i = 1; i < 3; ++ i) {
+		n[i].x = n[0].x + nearest_image(n[i].x - n[0].x, g->size);
+		n[i].y = n[0].y + nearest_image(n[i].y - n[0].y, g->size);
+	}
+}
+
+static uint32_t
+next_tree(struct stream_graph *g)
+{
+	uint32_t t = vector_size(g->trees);
+	vector_pushz(&g->trees);
+	return t;
+}
+
+static void
+reset_nodes(void *arg, size_t n0, size_t n1)
+{
+	struct stream_pass *pass = arg;
+	struct stream_graph *g = pass->g;
+	for (size_t ni = n0; ni < n1; ++ ni) {
+		g->nodes[ni].tree = NO_NODE;
+		g->nodes[ni].drainage = 0;
+		g->arcs[ni].receiver = NO_NODE;
 	}
+}
 
-	/* Calculate slope and perform thermal erosion */
+static void
+select_receivers(void *arg, size_t n0, size_t n1)
+{
+	struct stream_pass *pass = arg;
+	struct stream_graph *g = pass->g;
+	for (size_t ni = n0; ni < n1; ++ ni) {
+		/*
+		 * Only strictly lower neighbors. Do not use FLT_EPSILON;
+		 * results in many lakes.
+		 */
+		float lowest = g->nodes[ni].height;
+		for (uint32_t a = g->adjacency_start[ni]; a < g->adjacency_start[ni+1]; ++ a) {
+			uint32_t nb = g->adjacency[a];
+			if (g->nodes[nb].height < lowest) {
+				lowest = g->nodes[nb].height;
+				g->arcs[ni].receiver = nb;
+			}
+		}
+	}
+}
+
+static void
+talus_outflow(void *arg, size_t n0, size_t n1)
+{
+	struct stream_pass *pass = arg;
+	struct stream_graph *g = pass->g;
+	const float talus = 0.3f;
+	for (size_t ni = n0; ni < n1; ++ ni) {
+		pass->talus_xfer[ni] = 0;
+		uint32_t rcv = g->arcs[ni].receiver;
+		if (rcv == NO_NODE)
+			continue;
+		float d = g->nodes[ni].height - g->nodes[rcv].height;
+		if (d > talus)
+			pass->talus_xfer[ni] = (d - talus) / 4;
+	}
+}
+
+static void
+talus_inflow(void *arg, size_t n0, size_t n1)
+{
+	struct stream_pass *pass = arg;
+	struct stream_graph *g = pass->g;
+	for (size_t ni = n0; ni < n1; ++ ni) {
+		float h = g->nodes[ni].height - pass->talus_xfer[ni];
+		for (uint32_t d = pass->donor_start[ni]; d < pass->donor_start[ni + 1]; ++ d)
+			h += pass->talus_xfer[pass->donors[d]];
+		g->nodes[ni].height = h;
+	}
+}
+
+/*
+ * Counts the donors of each node and stores them contiguously, as described
+ * by Braun and Willett 2013. Starting from any root and visiting donors in
+ * turn visits each node after its receiver, without recursion.
+ *
+ * Braun, Jean & Willett, Sean. (2013). A very efficient O(n), implicit and
+ * parallel method to solve the stream power equation governing fluvial
+ * incision and landscape evolution. Geomorphology. 180-181. 170-179.
+ */
+static void
+find_donors(const struct stream_graph *g, struct stream_pass *pass)
+{
+	pass->donor_start = xcalloc(g->node_count + 1, sizeof(*pass->donor_start));
+	pass->donors = xmalloc(g->node_count * sizeof(*pass->donors));
+	uint32_t *fill = xmalloc(g->node_count * sizeof(*fill));
+	for (uint32_t ni = 0; ni < g->node_count; ++ ni) {
+		uint32_t rcv = g->arcs[ni].receiver;
+		if (rcv != NO_NODE)
+			++ pass->donor_start[rcv + 1];
+	}
+	for (uint32_t ni = 0; ni < g->node_count; ++ ni)
+		pass->donor_start[ni + 1] += pass->donor_start[ni];
+	memcpy(fill, pass->donor_start, g->node_count * sizeof(*fill));
 	for (uint32_t ni = 0; ni < g->node_count; ++ ni) {
-		struct stream_arc *arc = &g->arcs[ni];
-		if (arc->receiver == NO_NODE)
+		uint32_t rcv = g->arcs[ni].receiver;
+		if (rcv != NO_NODE)
+			pass->donors[fill[rcv] ++] = ni;
+	}
+	free(fill);
+}
+
+static void
+label_trees(void *arg, size_t t0, size_t t1)
+{
+	struct stream_pass *pass = arg;
+	struct stream_graph *g = pass->g;
+	uint32_t *stack = NULL; /* vector */
+	for (size_t ti = t0; ti < t1; ++ ti) {
+		vector_push(&stack, g->trees[ti].root);
+		while (vector_size(stack)) {
+			uint32_t ni = *vector_tail(stack);
+			vector_pop(&stack);
+			for (uint32_t d = pass->donor_start[ni]; d < pass->donor_start[ni + 1]; ++ d) {
+				g->nodes[pass->donors[d]].tree = ti;
+				vector_push(&stack, pass->donors[d]);
+			}
+		}
+	}
+	vector_free(&stack);
+}
+
+static void
+erode_basins(void *arg, size_t t0, size_t t1)
+{
+	struct stream_pass *pass = arg;
+	struct stream_graph *g = pass->g;
+	uint32_t *order = NULL; /* vector */
+	for (size_t ti = t0; ti < t1; ++ ti) {
+		/* Trees with a receiver belong to another basin */
+		if (g->trees[ti].node_receiver != NO_NODE)
 			continue;
 
-		struct stream_node *src = &g->nodes[ni];
-		struct stream_node *dst = &g->nodes[arc->receiver];
-		float d = src->height - dst->height;
-		const float talus = 0.3f;
-		if (d > talus) {
-			float xfer = (d - talus) / 4;
-			dst->height += xfer;
-			src->height -= xfer;
+		/* Order basin nodes such that each follows its receiver */
+		vector_clear(&order);
+		vector_push(&order, g->trees[ti].root);
+		for (size_t head = 0; head < vector_size(order); ++ head) {
+			uint32_t ni = order[head];
+			for (uint32_t d = pass->donor_start[ni]; d < pass->donor_start[ni + 1]; ++ d)
+				vector_push(&order, pass->donors[d]);
 		}
+		size_t order_size = vector_size(order);
+
+		/* Calculate drainage area */
+		for (size_t ix = order_size; ix > 0; -- ix)
+			flow_drainage_area(g, order[ix-1]);
+
+		/*
+		 * I really don't understand the stream power equation, so I
+		 * can't rightfully say that's what I'm calculating here...
+		 */
+		for (size_t i = 0; i < order_size; ++ i)
+			stream_power(g, order[i]);
 	}
+	vector_free(&order);
+}
 
-	/* Generate depth queue */
-	uint32_t *depth_queue = NULL; /* vector */
-	for (uint32_t ni = 0; ni < g->node_count; ++ ni)
-		add_to_depth_queue(g, &depth_queue, ni);
+/*
+ * Lakes are resolved as described by Cordonnier et al: trees form a graph,
+ * joined by the lowest pass between each pair, and water flows from each
+ * tree towards a lake along the minimum spanning tree of that graph. Along
+ * that path the highest pass is as low as it could possibly be, and that
+ * height becomes the tree's pass_to_receiver.
+ *
+ * We collect the lowest pass between each pair of trees in a single sweep of
+ * each node's neighbors, build the minimum spanning tree with Kruskal's
+ * algorithm, then walk it outwards from the lakes. Links are sorted by (pass,
+ * node indices) so the result is the same each time.
+ */
+static void
+resolve_lakes(struct stream_graph *g)
+{
+	const uint32_t tree_count = vector_size(g->trees);
+	const uint32_t lake = tree_count;
+	struct lake_link *links = NULL; /* vector */
+	size_t mask = 1;
+	while (mask < (size_t)LAKE_LINK_TABLE_SCALE * (tree_count + 1))
+		mask <<= 1;
+	uint32_t *table = xcalloc(mask, sizeof(*table));
+	-- mask;
+
+	for (uint32_t a = 0; a < g->node_count; ++ a)
+	for (uint32_t j = g->adjacency_start[a]; j < g->adjacency_start[a+1]; ++ j) {
+		uint32_t b = g->adjacency[j];
+		if (b < a)
+			continue; /* Only visit each edge once */
+		uint32_t ta = g->nodes[a].tree;
+		uint32_t tb = g->nodes[b].tree;
+		if (g->trees[ta].is_lake)
+			ta = lake;
+		if (g->trees[tb].is_lake)
+			tb = lake;
+		if (ta == tb)
+			continue;
+		struct lake_link link = {
+			.t0 = MIN(ta, tb),
+			.t1 = MAX(ta, tb),
+			.a = a,
+			.b = b,
+			.pass = MAX(g->nodes[a].height, g->nodes[b].height)
+		};
+		uint32_t *slot = lake_link_slot(table, mask, links, link.t0, link.t1);
+		if (*slot) {
+			/* Earlier nodes win ties, which keeps this deterministic */
+			struct lake_link *prev = links + *slot - 1;
+			if (link.pass < prev->pass)
+				*prev = link;
+			continue;
+		}
+		vector_push(&links, link);
+		*slot = vector_size(links);
 
-	/* Calculate drainage area */
-	uint32_t depth_queue_size = vector_size(depth_queue);
-	for (uint32_t ix = depth_queue_size; ix > 0; -- ix)
-		flow_drainage_area(g, depth_queue[ix-1]);
+		/* Grow the table past half full */
+		if (vector_size(links) * 2 > mask) {
+			free(table);
+			mask = mask * 2 + 1;
+			table = xcalloc(mask + 1, sizeof(*table));
+			for (size_t i = 0; i < vector_size(links); ++ i)
+				*lake_link_slot(table, mask, links, links[i].t0, links[i].t1) = i + 1;
+		}
+	}
+	free(table);
+
+	/* Kruskal's algorithm, links joining trees already joined are dropped */
+	size_t link_count = vector_size(links);
+	if (link_count)
+		qsort(links, link_count, sizeof(*links), cmp_lake_link);
+	uint32_t *parent = xmalloc((tree_count + 1) * sizeof(*parent));
+	for (uint32_t t = 0; t <= tree_count; ++ t)
+		parent[t] = t;
+	size_t mst_count = 0;
+	for (size_t i = 0; i < link_count; ++ i) {
+		uint32_t r0 = find_set(parent, links[i].t0);
+		uint32_t r1 = find_set(parent, links[i].t1);
+		if (r0 == r1)
+			continue;
+		parent[MAX(r0, r1)] = MIN(r0, r1);
+		links[mst_count ++] = links[i];
+	}
+
+	/* Links of the spanning tree incident to each tree, stored contiguously */
+	uint32_t *mst_start = xcalloc(tree_count + 2, sizeof(*mst_start));
+	uint32_t *mst = xmalloc(2 * mst_count * sizeof(*mst));
+	for (size_t i = 0; i < mst_count; ++ i) {
+		++ mst_start[links[i].t0 + 1];
+		++ mst_start[links[i].t1 + 1];
+	}
+	for (uint32_t t = 0; t <= tree_count; ++ t)
+		mst_start[t + 1] += mst_start[t];
+	uint32_t *fill = parent; /* no longer needed */
+	memcpy(fill, mst_start, (tree_count + 1) * sizeof(*fill));
+	for (size_t i = 0; i < mst_count; ++ i) {
+		mst[fill[links[i].t0] ++] = i;
+		mst[fill[links[i].t1] ++] = i;
+	}
 
 	/*
-	 * I really don't understand the stream power equation, so I can't
-	 * rightfully say that's what I'm calculating here...
+	 * Walk outwards from the lakes. Each tree reached flows to the node
+	 * on the other side of the link we reached it by.
 	 */
-	for (uint32_t i = 0; i < depth_queue_size; ++ i)
-		stream_power(g, depth_queue[i]);
+	uint32_t *queue = fill;
+	uint32_t head = 0;
+	uint32_t tail = 0;
+	queue[tail ++] = lake;
+	while (head < tail) {
+		uint32_t from = queue[head ++];
+		float from_pass = from == lake ? 0 : g->trees[from].pass_to_receiver;
+		for (uint32_t m = mst_start[from]; m < mst_start[from + 1]; ++ m) {
+			struct lake_link *link = links + mst[m];
+			uint32_t to = link->t0 == from ? link->t1 : link->t0;
+			struct stream_tree *t = &g->trees[to];
+			if (to == lake || t->node_receiver != NO_NODE)
+				continue; /* Where we came from */
+			uint32_t rcv = g->nodes[link->a].tree == to ? link->b : link->a;
+			t->pass_to_receiver = MAX(from_pass, link->pass);
+			t->lake_receiver = g->nodes[rcv].tree;
+			t->node_receiver = rcv;
+			queue[tail ++] = to;
+		}
+	}
 
-	vector_free(&depth_queue);
+	free(mst);
+	free(mst_start);
+	free(parent);
+	vector_free(&links);
 }
 
-static void
-assign_tree(struct stream_graph *g, uint32_t nid, uint32_t **upstream)
+/* Slot of the link between two trees in an open addressed table */
+static uint32_t *
+lake_link_slot(uint32_t *table, size_t mask, const struct lake_link *links,
+               uint32_t t0, uint32_t t1)
 {
-	struct stream_node *n = &g->nodes[nid];
-	/* Traverse arcs to first downstream node with tree */
-	while (n->tree == NO_NODE) {
-		vector_push(upstream, nid);
-		nid = g->arcs[nid].receiver;
-		n = &g->nodes[nid];
+	size_t h = ((uint64_t)t0 << 32 | t1) * 0x9E3779B97F4A7C15ull >> 32;
+	for (;; ++ h) {
+		uint32_t *slot = table + (h & mask);
+		if (!*slot)
+			return slot;
+		const struct lake_link *l = links + *slot - 1;
+		if (l->t0 == t0 && l->t1 == t1)
+			return slot;
 	}
+}
 
-	/* Assign root tree to upstream */
-	size_t upstream_size = vector_size(*upstream);
-	for (size_t i = 0; i < upstream_size; ++ i)
-		g->nodes[(*upstream)[i]].tree = n->tree;
-
-	vector_clear(upstream);
+static int
+cmp_lake_link(const void *a, const void *b)
+{
+	const struct lake_link *x = a;
+	const struct lake_link *y = b;
+	if (x->pass != y->pass)
+		return x->pass < y->pass ? -1 : 1;
+	if (x->a != y->a)
+		return x->a < y->a ? -1 : 1;
+	return (x->b > y->b) - (x->b < y->b);
 }
 
+/* Union-find root, halving the path as we go */
 static uint32_t
-next_tree(struct stream_graph *g)
+find_set(uint32_t *parent, uint32_t i)
 {
-	uint32_t t = vector_size(g->trees);
-	vector_pushz(&g->trees);
-	return t;
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
 }
 
 static void
@@ -410,13 +798,260 @@ stream_power(struct stream_graph *g, uint32_t ni)
 	}
 }
 
+/*
+ * Inserts the edge a < b into an open addressed set, returning whether it
+ * wasn't already present. Since b > 0 no key is ever 0, which marks empty.
+ */
+static int
+edge_set_insert(uint64_t *set, size_t mask, uint32_t a, uint32_t b)
+{
+	uint64_t key = (uint64_t)a << 32 | b;
+	for (size_t h = key * 0x9E3779B97F4A7C15ull >> 32; ; ++ h) {
+		uint64_t *slot = set + (h & mask);
+		if (*slot == key)
+			return 0;
+		if (*slot == 0) {
+			*slot = key;
+			return 1;
+		}
+	}
+}
+
+/*
+ * Each edge appears in the adjacency of both its nodes. Edges are pushed in
+ * triangle order, so sort each node's neighbors to keep scans in index order.
+ */
 static void
-add_to_depth_queue(struct stream_graph *g, uint32_t **depth_queue, uint32_t ni)
+build_adjacency(struct stream_graph *g)
 {
-	if (g->nodes[ni].unwound)
-		return;
-	if (g->arcs[ni].receiver != NO_NODE)
-		add_to_depth_queue(g, depth_queue, g->arcs[ni].receiver);
-	vector_push(depth_queue, ni);
-	g->nodes[ni].unwound = 1;
+	uint32_t edge_count = vector_size(g->edges);
+	uint32_t *start = xcalloc(g->node_count + 1, sizeof(*start));
+	uint32_t *adj = xmalloc(2 * (size_t)edge_count * sizeof(*adj));
+	for (uint32_t ei = 0; ei < edge_count; ++ ei) {
+		++ start[g->edges[ei].a + 1];
+		++ start[g->edges[ei].b + 1];
+	}
+	for (uint32_t ni = 0; ni < g->node_count; ++ ni)
+		start[ni + 1] += start[ni];
+	uint32_t *fill = xmalloc(g->node_count * sizeof(*fill));
+	memcpy(fill, start, g->node_count * sizeof(*fill));
+	for (uint32_t ei = 0; ei < edge_count; ++ ei) {
+		adj[fill[g->edges[ei].a] ++] = g->edges[ei].b;
+		adj[fill[g->edges[ei].b] ++] = g->edges[ei].a;
+	}
+	free(fill);
+
+	/* Only a handful of neighbors each, insertion sort is fine */
+	for (uint32_t ni = 0; ni < g->node_count; ++ ni)
+	for (uint32_t a = start[ni] + 1; a < start[ni+1]; ++ a)
+	for (uint32_t b = a; b > start[ni] && adj[b-1] > adj[b]; -- b) {
+		uint32_t tmp = adj[b];
+		adj[b] = adj[b-1];
+		adj[b-1] = tmp;
+	}
+
+	g->adjacency_start = start;
+	g->adjacency = adj;
+}
+
+/* Sorts points in place along a Hilbert curve over the map */
+static void
+sort_hilbert(float *pt, size_t npt, unsigned long size)
+{
+	uint32_t len = 1;
+	while (len < size / HILBERT_CELL && len < HILBERT_MAX_LEN)
+		len <<= 1;
+	float scale = len / (float)size;
+
+	/* Curve index in the high bits, original index breaks ties */
+	uint64_t *key = xmalloc(npt * sizeof(*key));
+	for (size_t i = 0; i < npt; ++ i) {
+		uint32_t x = MIN((uint32_t)(pt[i*2+0] * scale), len - 1);
+		uint32_t y = MIN((uint32_t)(pt[i*2+1] * scale), len - 1);
+		key[i] = (uint64_t)hilbert_index(len, x, y) << 32 | i;
+	}
+	qsort(key, npt, sizeof(*key), cmp_uint64);
+
+	float *sorted = xmalloc(npt * 2 * sizeof(*sorted));
+	for (size_t i = 0; i < npt; ++ i) {
+		uint32_t src = (uint32_t)key[i];
+		sorted[i*2+0] = pt[src*2+0];
+		sorted[i*2+1] = pt[src*2+1];
+	}
+	memcpy(pt, sorted, npt * 2 * sizeof(*pt));
+	free(sorted);
+	free(key);
+}
+
+/*
+ * Distance along the Hilbert curve filling a len by len grid, len a power of
+ * two, of cell (x,y). Each step picks the quadrant then rotates/flips the
+ * remaining coordinates into that quadrant's orientation.
+ */
+static uint32_t
+hilbert_index(uint32_t len, uint32_t x, uint32_t y)
+{
+	uint32_t d = 0;
+	for (uint32_t s = len / 2; s > 0; s /= 2) {
+		uint32_t rx = (x & s) != 0;
+		uint32_t ry = (y & s) != 0;
+		d += s * s * ((3 * rx) ^ ry);
+		if (ry == 0) {
+			if (rx == 1) {
+				x = len - 1 - x;
+				y = len - 1 - y;
+			}
+			uint32_t tmp = x;
+			x = y;
+			y = tmp;
+		}
+	}
+	return d;
+}
+
+static void
+build_index(struct stream_graph *g)
+{
+	struct stream_index *ix = &g->index;
+	ix->len = MAX(1, g->size / STREAM_INDEX_CELL);
+	size_t cell_count = (size_t)ix->len * ix->len;
+	uint32_t tri_count = vector_size(g->tris);
+
+	/* Count the entries of each cell, offset by one */
+	ix->node_start = xcalloc(cell_count + 1, sizeof(*ix->node_start));
+	ix->tri_start  = xcalloc(cell_count + 1, sizeof(*ix->tri_start));
+	for (uint32_t ni = 0; ni < g->node_count; ++ ni) {
+		long x = index_coord(g, g->nodes[ni].x);
+		long y = index_coord(g, g->nodes[ni].y);
+		++ ix->node_start[index_cell(g, x, y) + 1];
+	}
+	for (uint32_t ti = 0; ti < tri_count; ++ ti) {
+		long xs[2], ys[2];
+		index_tri_span(g, ti, xs, ys);
+		for (long y = ys[0]; y <= ys[1]; ++ y)
+		for (long x = xs[0]; x <= xs[1]; ++ x)
+			++ ix->tri_start[index_cell(g, x, y) + 1];
+	}
+	for (size_t c = 0; c < cell_count; ++ c) {
+		ix->node_start[c+1] += ix->node_start[c];
+		ix->tri_start[c+1] += ix->tri_start[c];
+	}
+
+	/* Fill cells in index order, so each list is sorted */
+	uint32_t *fill = xmalloc(cell_count * sizeof(*fill));
+	ix->nodes = xmalloc(ix->node_start[cell_count] * sizeof(*ix->nodes));
+	memcpy(fill, ix->node_start, cell_count * sizeof(*fill));
+	for (uint32_t ni = 0; ni < g->node_count; ++ ni) {
+		long x = index_coord(g, g->nodes[ni].x);
+		long y = index_coord(g, g->nodes[ni].y);
+		ix->nodes[fill[index_cell(g, x, y)] ++] = ni;
+	}
+	ix->tris = xmalloc(ix->tri_start[cell_count] * sizeof(*ix->tris));
+	memcpy(fill, ix->tri_start, cell_count * sizeof(*fill));
+	for (uint32_t ti = 0; ti < tri_count; ++ ti) {
+		long xs[2], ys[2];
+		index_tri_span(g, ti, xs, ys);
+		for (long y = ys[0]; y <= ys[1]; ++ y)
+		for (long x = xs[0]; x <= xs[1]; ++ x)
+			ix->tris[fill[index_cell(g, x, y)] ++] = ti;
+	}
+	free(fill);
+}
+
+/* Unwrapped cells spanned by the bounding box of a triangle */
+static void
+index_tri_span(const struct stream_graph *g, uint32_t ti,
+               long xs[2], long ys[2])
+{
+	struct stream_node n[3];
+	stream_graph_tri_nodes(g, ti, n);
+	index_span(g, MIN(n[0].x, MIN(n[1].x, n[2].x)),
+	              MAX(n[0].x, MAX(n[1].x, n[2].x)), xs);
+	index_span(g, MIN(n[0].y, MIN(n[1].y, n[2].y)),
+	              MAX(n[0].y, MAX(n[1].y, n[2].y)), ys);
+}
+
+/* Unwrapped cell coordinate of a stream graph coordinate */
+static long
+index_coord(const struct stream_graph *g, float x)
+{
+	return floorf(x * g->index.len / g->size);
+}
+
+/* Unwrapped cells spanning [lo,hi], never covering any cell twice */
+static void
+index_span(const struct stream_graph *g, float lo, float hi, long span[2])
+{
+	span[0] = index_coord(g, lo);
+	span[1] = index_coord(g, hi);
+	span[1] = MIN(span[1], span[0] + (long)g->index.len - 1);
+}
+
+static size_t
+index_cell(const struct stream_graph *g, long x, long y)
+{
+	return wrapidx(y, g->index.len) * g->index.len + wrapidx(x, g->index.len);
+}
+
+/* Shortest of the distances d, d-size and d+size */
+static float
+nearest_image(float d, float size)
+{
+	if (d > size / 2)
+		return d - size;
+	if (d < -size / 2)
+		return d + size;
+	return d;
+}
+
+/* Insertion into the k nearest nodes found so far, ties broken by index */
+static void
+nearest_insert(uint32_t *nodes, float *dist, size_t *found, size_t k,
+               uint32_t ni, float d)
+{
+	size_t i = *found;
+	if (i == k) {
+		if (d > dist[k-1] || (d == dist[k-1] && ni > nodes[k-1]))
+			return;
+		i = k - 1;
+	} else {
+		++ *found;
+	}
+	while (i > 0 && (dist[i-1] > d || (dist[i-1] == d && nodes[i-1] > ni))) {
+		nodes[i] = nodes[i-1];
+		dist[i] = dist[i-1];
+		-- i;
+	}
+	nodes[i] = ni;
+	dist[i] = d;
+}
+
+static int
+cmp_uint32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+static int
+cmp_uint64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static int
+cmp_stream_tri(const void *a, const void *b)
+{
+	const struct stream_tri *x = a;
+	const struct stream_tri *y = b;
+	uint32_t kx[4] = { MIN(x->a, MIN(x->b, x->c)), x->a, x->b, x->c };
+	uint32_t ky[4] = { MIN(y->a, MIN(y->b, y->c)), y->a, y->b, y->c };
+	for (size_t i = 0; i < 4; ++ i) {
+		if (kx[i] != ky[i])
+			return kx[i] < ky[i] ? -1 : 1;
+	}
+	return 0;
 }
@@ -1,6 +1,9 @@
 #include "hammer/math.h"
 #include "hammer/mem.h"
+#include "hammer/neighborhood.h"
+#include "hammer/noise_field.h"
 #include "hammer/opensimplex.h"
+#include "hammer/parallel.h"
 #include "hammer/ring.h"
 #include "hammer/vector.h"
 #include "hammer/worldgen/tectonic.h"
@@ -89,11 +92,31 @@ static void divergent_cell(struct lithosphere *, uint32_t,
 static void lithosphere_create_plates(struct lithosphere *,
                                       const struct world_opts *);
 
+/*
+ * Blits every plate onto the lithosphere, identifying collisions. Bands of
+ * rows are blitted in parallel, see lithosphere_blit_plates() for details.
+ */
+static void lithosphere_blit_plates(struct lithosphere *,
+                                    const struct world_opts *);
+
 /*
  * Initializes the mass map with coherent wrapping noise.
  */
 static void lithosphere_init_mass(struct lithosphere *);
 
+/*
+ * Rows of noise evaluated by lithosphere_init_mass() and lithosphere_blit(),
+ * see noise_field_rows().
+ */
+struct blit_uplift_args {
+	const struct lithosphere *l;
+	float                    *uplift;
+	unsigned long             size;
+};
+static void init_igneous_row(void *, size_t y, float *const *rows);
+static void init_sediment_row(void *, size_t y, float *const *rows);
+static void blit_uplift_row(void *, size_t y, float *const *rows);
+
 /*
  * Performs one iteration of the tectonic uplift algorithm.
  */
@@ -115,10 +138,17 @@ static void plate_collide(struct lithosphere *l,
                           uint16_t src_si, uint16_t dst_si);
 
 /*
- * Blit plate mass onto lithosphere, perform subduction and collision mass
- * transfer and identify collisions which may result in segments merging.
+ * Blit plate mass onto rows [y0,y1) of the lithosphere, perform subduction
+ * and collision mass transfer and identify collisions which may result in
+ * segments merging. Collisions between segment pairs not yet in
+ * collision_set are appended to collisions, and if segment_pairs is not NULL
+ * the colliding pair is appended to it.
  */
 static void plate_blit(struct lithosphere *, uint32_t pi,
+                       uint32_t y0, uint32_t y1,
+                       struct collision **collisions,
+                       uint16_t **segment_pairs,
+                       uint8_t collision_set[COLLISION_SET_BYTES],
                        const struct world_opts *);
 
 /*
@@ -128,6 +158,13 @@ static void plate_cell_collision(struct plate *p, uint32_t wx, uint32_t wy,
                                  struct tectonic_mass_composition m,
                                  uint16_t si);
 
+/*
+ * Fills in the plate's blit coordinate maps. Returns whether two rows of the
+ * lithosphere map onto the same row of this plate, which can happen due to
+ * rounding when the plate is translated by half a cell.
+ */
+static int plate_blit_map(struct plate *);
+
 /*
  * Frees memory associated with a plate.
  */
@@ -158,21 +195,44 @@ static void plate_set_mass(struct plate *, uint32_t wx, uint32_t wy,
                            struct tectonic_mass_composition mass,
                            uint16_t si);
 
-/* Removes sediment first, then metamorphic, then igneous */
-static void remove_mass(struct tectonic_mass_composition *m, float remove);
+/*
+ * Removes sediment first, then metamorphic, then igneous, and updates the
+ * cell's total mass.
+ */
+static void remove_mass(struct tectonic_mass_composition *m, float *total,
+                        float remove);
+
+/* Sums the composition of a cell, see tectonic_mass_composition */
+static float mass_total(const struct tectonic_mass_composition *m);
 
 /*
- * Calculates the total area two segments overlap. This is a very expensive
- * operation.
+ * Calculates the total area two segments overlap. Overlap is counted 64 cells
+ * at a time by ANDing segment occupancy bitmaps, unless either segment has
+ * spilled out of its bounding box, in which case we fall back to checking
+ * cell by cell. Either way this relies on the plates' blit coordinate maps
+ * being valid for this step.
+ *
+ * segment_overlap_memo() returns a memoized overlap if this pair has been
+ * seen since the last step or merge.
+ *
+ * segment_occupancy() builds the segment's occupancy bitmap if need be, and
+ * occupancy_bits() extracts n bits of a bitmap row of width w starting at
+ * column x, where columns beyond w are empty.
  */
 static uint32_t segment_overlap(struct plate *p0, struct plate *p1,
                                 uint16_t si0, uint16_t si1);
+static uint32_t segment_overlap_memo(struct lithosphere *,
+                                     struct plate *p0, struct plate *p1,
+                                     uint16_t si0, uint16_t si1);
+static void segment_occupancy(struct plate *, uint16_t si);
+static uint64_t occupancy_bits(const uint64_t *row, uint32_t w, uint32_t x,
+                               unsigned n);
 
 /*
  * Utility functions to wrap a potentially negative coordinate to the bounds
  * of a lithosphere map and convert between lithosphere and plate coordinates.
  */
-#define wrap(X) wrapidx(X,LITHOSPHERE_LEN)
+#define wrap(X) WRAPIDX_POW2(X,LITHOSPHERE_SCALE)
 
 static void
 lithosphere_to_plate(struct plate *p, uint32_t lx, uint32_t ly, uint32_t pxy[2])
@@ -188,6 +248,59 @@ plate_to_lithosphere(struct plate *p, uint32_t px, uint32_t py, uint32_t lxy[2])
 	lxy[1] = wrap(lroundf(py - p->ty));
 }
 
+/*
+ * Plate cells are addressed by their plate space index, y * LITHOSPHERE_LEN
+ * + x, just as if the plate were one big array. plate_tile() returns the tile
+ * holding a cell, or NULL if it was never allocated, and plate_tile_alloc()
+ * allocates it if need be. tile_cell() is the index of a cell within its tile.
+ *
+ * plate_total_mass() and plate_in_segment() read a cell which may not have a
+ * tile.
+ */
+static struct plate_tile *
+plate_tile(const struct plate *p, size_t i)
+{
+	uint32_t tx = (i % LITHOSPHERE_LEN) / PLATE_TILE_LEN;
+	uint32_t ty = (i / LITHOSPHERE_LEN) / PLATE_TILE_LEN;
+	return p->tiles[ty * PLATE_TILES_LEN + tx];
+}
+
+static struct plate_tile *
+plate_tile_alloc(struct plate *p, size_t i)
+{
+	uint32_t tx = (i % LITHOSPHERE_LEN) / PLATE_TILE_LEN;
+	uint32_t ty = (i / LITHOSPHERE_LEN) / PLATE_TILE_LEN;
+	struct plate_tile **t = p->tiles + ty * PLATE_TILES_LEN + tx;
+	if (!*t) {
+		*t = xmalloc(sizeof(**t));
+		memset((*t)->mass, 0, sizeof((*t)->mass));
+		memset((*t)->total_mass, 0, sizeof((*t)->total_mass));
+		memset((*t)->in_segment, 0xFF, sizeof((*t)->in_segment));
+	}
+	return *t;
+}
+
+static size_t
+tile_cell(size_t i)
+{
+	return (i / LITHOSPHERE_LEN % PLATE_TILE_LEN) * PLATE_TILE_LEN +
+	       i % PLATE_TILE_LEN;
+}
+
+static float
+plate_total_mass(const struct plate *p, size_t i)
+{
+	struct plate_tile *t = plate_tile(p, i);
+	return t ? t->total_mass[tile_cell(i)] : 0;
+}
+
+static uint16_t
+plate_in_segment(const struct plate *p, size_t i)
+{
+	struct plate_tile *t = plate_tile(p, i);
+	return t ? t->in_segment[tile_cell(i)] : NO_SEGMENT;
+}
+
 void
 lithosphere_create(struct lithosphere *l, const struct world_opts *opts)
 {
@@ -200,6 +313,10 @@ void
 lithosphere_destroy(struct lithosphere *l)
 {
 	vector_free(&l->collisions);
+	for (size_t b = 0; b < LITHOSPHERE_BLIT_BANDS; ++ b) {
+		vector_free(&l->blit_bands[b].collisions);
+		vector_free(&l->blit_bands[b].segment_pairs);
+	}
 	size_t plate_count = vector_size(l->plates);
 	for (uint32_t p = 0; p < plate_count; ++ p)
 		plate_destroy(l->plates + p);
@@ -230,35 +347,42 @@ lithosphere_blit(struct lithosphere *l, float *uplift, unsigned long size)
 		opensimplex_alloc(WELL512i(l->rng)),
 		opensimplex_alloc(WELL512i(l->rng))
 	};
-	const float s = size / LITHOSPHERE_LEN;
-	const float wf = 1.0f / 15;
-	const float frq = 24;
-	for (uint32_t y = 0; y < size; ++ y)
-	for (uint32_t x = 0; x < size; ++ x) {
-		/* See lithosphere_init_mass for an explanation */
-		size_t i = y * size + x;
-		float u = (float)x / size;
-		float v = (float)y / size;
-		float nx = cosf(u*2*M_PI)*frq/(2*M_PI);
-		float ny = sinf(v*2*M_PI)*frq/(2*M_PI);
-		float nz = sinf(u*2*M_PI)*frq/(2*M_PI);
-		float nw = cosf(v*2*M_PI)*frq/(2*M_PI);
-		nx += opensimplex4_fbm(n[0], nx*wf, ny*wf, nz*wf, nw*wf, 2, 4);
-		ny += opensimplex4_fbm(n[1], nx*wf, ny*wf, nz*wf, nw*wf, 2, 4);
-		nz += opensimplex4_fbm(n[2], nx*wf, ny*wf, nz*wf, nw*wf, 2, 4);
-		nw += opensimplex4_fbm(n[3], nx*wf, ny*wf, nz*wf, nw*wf, 2, 4);
-		float wx = opensimplex4_fbm(n[4], nx, ny, nz, nw, 4, 2);
-		float wy = opensimplex4_fbm(n[5], nx, ny, nz, nw, 4, 2);
-		size_t iw = wrap(lroundf(y / s + frq * wx)) * LITHOSPHERE_LEN +
-		            wrap(lroundf(x / s + frq * wy));
-		uplift[i] = l->mass[iw].sediment +
-		            l->mass[iw].metamorphic +
-		            l->mass[iw].igneous;
-	}
+	struct noise_field f;
+	noise_field_create(&f, size, size, 24);
+	/* Displacement within the lithosphere of each pixel */
+	struct noise_fbm displace = {
+		.warp = n,
+		.warp_scale = 1.0f / 15,
+		.warp_oct = 2,
+		.warp_per = 4,
+		.warp_cascade = 1,
+		.n = n + 4,
+		.count = 2,
+		.scale = 1,
+		.oct = 4,
+		.per = 2
+	};
+	struct blit_uplift_args args = { l, uplift, size };
+	noise_field_rows(&f, &displace, blit_uplift_row, &args);
+	noise_field_destroy(&f);
 	for (size_t i = 0; i < 6; ++ i)
 		free(n[i]);
 }
 
+static void
+blit_uplift_row(void *arg, size_t y, float *const *rows)
+{
+	const struct blit_uplift_args *args = arg;
+	const float s = args->size / LITHOSPHERE_LEN;
+	const float frq = 24;
+	for (uint32_t x = 0; x < args->size; ++ x) {
+		size_t i = y * args->size + x;
+		size_t iw = wrap(lroundf(y / s + frq * rows[0][x])) * LITHOSPHERE_LEN +
+		            wrap(lroundf(x / s + frq * rows[1][x]));
+		args->uplift[i] = args->l->total_mass[iw];
+	}
+}
+
 static void
 divergent_cell(struct lithosphere *l, uint32_t i,
                const struct world_opts *opts)
@@ -273,9 +397,7 @@ divergent_cell(struct lithosphere *l, uint32_t i,
 		if (dy == 0 && dx == 0)
 			continue;
 		uint32_t n = wrap(dy + y) * LITHOSPHERE_LEN + wrap(dx + x);
-		float nh = l->mass[n].sediment +
-		           l->mass[n].metamorphic +
-		           l->mass[n].igneous;
+		float nh = l->total_mass[n];
 		/* Normalize mass [0,1] between ocean floor and continent */
 		nh = (nh - TECTONIC_OCEAN_FLOOR_MASS) /
 		     (TECTONIC_CONTINENT_MASS - TECTONIC_OCEAN_FLOOR_MASS);
@@ -347,22 +469,14 @@ lithosphere_create_plates(struct lithosphere *l,
 			uint32_t src = *el;
 			uint32_t x = src % LITHOSPHERE_LEN;
 			uint32_t y = src / LITHOSPHERE_LEN;
-			/* Von Neumann neighbors, wrap edges */
-			uint32_t xm = x == 0 ? LITHOSPHERE_LEN-1 : x - 1;
-			uint32_t xp = x == LITHOSPHERE_LEN-1 ? 0 : x + 1;
-			uint32_t ym = y == 0 ? LITHOSPHERE_LEN-1 : y - 1;
-			uint32_t yp = y == LITHOSPHERE_LEN-1 ? 0 : y + 1;
 			/* Note: order of neighbors matters below! */
-			uint32_t neighbors[4] = {
-				y * LITHOSPHERE_LEN + xm,
-				y * LITHOSPHERE_LEN + xp,
-				ym * LITHOSPHERE_LEN + x,
-				yp * LITHOSPHERE_LEN + x
-			};
+			uint32_t neighbors[VON_NEUMANN_NEIGHBORHOOD_SIZE];
+			von_neumann_neighbors_pow2(neighbors, x, y,
+			                           LITHOSPHERE_SCALE);
 			/* Not very random. Will always access in pattern */
 			size_t rng_offset = WELL512i(l->rng) % 128;
-			for (size_t n = 0; n < 4; ++ n) {
-				size_t i = (n + rng_offset) % 4;
+			for (size_t n = 0; n < VON_NEUMANN_NEIGHBORHOOD_SIZE; ++ n) {
+				size_t i = (n + rng_offset) % VON_NEUMANN_NEIGHBORHOOD_SIZE;
 				uint32_t neighbor = neighbors[i];
 				if (l->owner[neighbor] != NO_PLATE)
 					continue;
@@ -373,15 +487,15 @@ lithosphere_create_plates(struct lithosphere *l,
 				struct plate *p = l->plates + l->owner[src];
 				uint32_t r = wrap((long)p->left + p->w - 1);
 				uint32_t b = wrap((long)p->top + p->h - 1);
-				if (i == 0 && p->left == x) {
+				if (i == VON_NEUMANN_NEIGHBOR_W && p->left == x) {
 					p->left = wrap((long)p->left-1);
 					++ p->w;
-				} else if (i == 2 && p->top == y) {
+				} else if (i == VON_NEUMANN_NEIGHBOR_N && p->top == y) {
 					p->top = wrap((long)p->top-1);
 					++ p->h;
-				} else if (i == 1 && r == x) {
+				} else if (i == VON_NEUMANN_NEIGHBOR_E && r == x) {
 					++ p->w;
-				} else if (i == 3 && b == y) {
+				} else if (i == VON_NEUMANN_NEIGHBOR_S && b == y) {
 					++ p->h;
 				}
 				goto neighbor_claimed;
@@ -411,7 +525,9 @@ lithosphere_create_plates(struct lithosphere *l,
 			size_t i = wrap(p->top  + y) * LITHOSPHERE_LEN +
 			           wrap(p->left + x);
 			if (l->owner[i] == pi) {
-				p->mass[i] = l->mass[i];
+				struct plate_tile *t = plate_tile_alloc(p, i);
+				t->mass[tile_cell(i)] = l->mass[i];
+				t->total_mass[tile_cell(i)] = l->total_mass[i];
 			}
 		}
 		plate_init_velocity(p, l->rng);
@@ -420,6 +536,81 @@ lithosphere_create_plates(struct lithosphere *l,
 	ring_free(&growing);
 }
 
+struct blit_plates_args {
+	struct lithosphere *l;
+	const struct world_opts *opts;
+};
+
+static void
+blit_plates_band(void *arg, size_t y0, size_t y1)
+{
+	struct blit_plates_args *a = arg;
+	struct blit_band *b = &a->l->blit_bands[y0 / LITHOSPHERE_BLIT_BAND_ROWS];
+	vector_clear(&b->collisions);
+	vector_clear(&b->segment_pairs);
+	memset(b->collision_set, 0, COLLISION_SET_BYTES);
+	size_t plate_count = vector_size(a->l->plates);
+	for (uint32_t pi = 0; pi < plate_count; ++ pi) {
+		plate_blit(a->l, pi, y0, y1,
+		           &b->collisions, &b->segment_pairs, b->collision_set,
+		           a->opts);
+	}
+}
+
+static void
+lithosphere_blit_plates(struct lithosphere *l, const struct world_opts *opts)
+{
+	size_t plate_count = vector_size(l->plates);
+
+	/*
+	 * Everything plate_blit touches while blitting a lithosphere row is
+	 * either in that row or in the row of each plate it maps to. As long
+	 * as that mapping is one-to-one, bands of rows never touch the same
+	 * cell and we can blit every plate band by band in parallel, with
+	 * exactly the same result as blitting plate by plate.
+	 *
+	 * If rounding maps two rows onto the same plate row the order those
+	 * rows are processed in matters, so fall back to a serial blit.
+	 */
+	int rows_alias = 0;
+	for (uint32_t pi = 0; pi < plate_count; ++ pi)
+		rows_alias |= plate_blit_map(l->plates + pi);
+	if (rows_alias) {
+		for (uint32_t pi = 0; pi < plate_count; ++ pi) {
+			plate_blit(l, pi, 0, LITHOSPHERE_LEN,
+			           &l->collisions, NULL, l->collision_set, opts);
+		}
+		return;
+	}
+
+	struct blit_plates_args args = { l, opts };
+	parallel_for(LITHOSPHERE_LEN, LITHOSPHERE_BLIT_BAND_ROWS,
+	             blit_plates_band, &args);
+
+	/*
+	 * Merge band collisions in the order a serial blit would have found
+	 * them: plate by plate, then row by row. Each band only deduplicated
+	 * its own collisions, so the first of each segment pair wins here.
+	 */
+	size_t cursor[LITHOSPHERE_BLIT_BANDS] = { 0 };
+	for (uint32_t pi = 0; pi < plate_count; ++ pi)
+	for (size_t bi = 0; bi < LITHOSPHERE_BLIT_BANDS; ++ bi) {
+		struct blit_band *b = &l->blit_bands[bi];
+		size_t collision_count = vector_size(b->collisions);
+		for (; cursor[bi] < collision_count; ++ cursor[bi]) {
+			struct collision *c = b->collisions + cursor[bi];
+			if (c->plate_index != pi)
+				break;
+			uint16_t cs = b->segment_pairs[cursor[bi]];
+			unsigned char m = 1 << (cs % 8);
+			if (l->collision_set[cs / 8] & m)
+				continue;
+			l->collision_set[cs / 8] |= m;
+			vector_push(&l->collisions, *c);
+		}
+	}
+}
+
 static void
 lithosphere_init_mass(struct lithosphere *l)
 {
@@ -430,50 +621,54 @@ lithosphere_init_mass(struct lithosphere *l)
 		opensimplex_alloc(WELL512i(l->rng)),
 		opensimplex_alloc(WELL512i(l->rng))
 	};
-	const float wf = 0.25f;
-	const float sf = 0.5f;
-	const float frq = 9.5f;
+	struct noise_field f;
+	noise_field_create(&f, LITHOSPHERE_LEN, LITHOSPHERE_LEN, 9.5f);
 
 	memset(l->mass, 0, LITHOSPHERE_AREA * sizeof(*l->mass));
 
-	for (uint32_t y = 0; y < LITHOSPHERE_LEN; ++ y)
-	for (uint32_t x = 0; x < LITHOSPHERE_LEN; ++ x) {
+	struct noise_fbm igneous = {
+		.warp = n,
+		.warp_scale = 0.25f,
+		.warp_oct = 2,
+		.warp_per = 4,
+		.n = n + 4,
+		.count = 1,
+		.scale = 1,
+		.oct = 4,
+		.per = 2
+	};
+	noise_field_rows(&f, &igneous, init_igneous_row, l);
+
+	struct noise_fbm sediment = {
+		.n = n,
+		.count = 1,
+		.scale = 0.5f,
+		.oct = 1,
+		.per = 1
+	};
+	noise_field_rows(&f, &sediment, init_sediment_row, l);
+
+	noise_field_destroy(&f);
+	for (size_t i = 0; i < 5; ++ i)
+		free(n[i]);
+}
+
+static void
+init_igneous_row(void *arg, size_t y, float *const *rows)
+{
+	struct lithosphere *l = arg;
+	for (size_t x = 0; x < LITHOSPHERE_LEN; ++ x)
+		l->mass[y * LITHOSPHERE_LEN + x].igneous = 1.2f + 1.5f * rows[0][x];
+}
+
+static void
+init_sediment_row(void *arg, size_t y, float *const *rows)
+{
+	struct lithosphere *l = arg;
+	for (size_t x = 0; x < LITHOSPHERE_LEN; ++ x) {
 		size_t i = y * LITHOSPHERE_LEN + x;
-		/*
-		 * To generate coherent wrapping noise we may project our
-		 * coordinates onto unit circles along orthogonal axis.
-		 *
-		 * Once you've attempted to do this in 2D you'll realize your
-		 * axis are warping due to, well, sine and cosine. This would
-		 * be a fine solution for a 1D noise image. What you actually
-		 * need are complementing 3rd and 4th axis, the same way sine
-		 * and cosine complement eachother for the 1D case.
-		 *
-		 * Once we have these cyclical 4D coordinates we can warp,
-		 * transform, and scale them just like our linear 2D
-		 * coordinates.
-		 *
-		 * TODO: This took me 48.7 years to massage into something
-		 * that works. Would be smart to turn it into a function.
-		 */
-		float u = (float)x / LITHOSPHERE_LEN;
-		float v = (float)y / LITHOSPHERE_LEN;
-		float nx = cosf(u*2*M_PI)*frq/(2*M_PI);
-		float ny = sinf(v*2*M_PI)*frq/(2*M_PI);
-		float nz = sinf(u*2*M_PI)*frq/(2*M_PI);
-		float nw = cosf(v*2*M_PI)*frq/(2*M_PI);
-		float nwx = nx + opensimplex4_fbm(n[0], nx*wf, ny*wf, nz*wf, nw*wf, 2, 4);
-		float nwy = ny + opensimplex4_fbm(n[1], nx*wf, ny*wf, nz*wf, nw*wf, 2, 4);
-		float nwz = nz + opensimplex4_fbm(n[2], nx*wf, ny*wf, nz*wf, nw*wf, 2, 4);
-		float nww = nw + opensimplex4_fbm(n[3], nx*wf, ny*wf, nz*wf, nw*wf, 2, 4);
-		l->mass[i].igneous = opensimplex4_fbm(n[4], nwx, nwy, nwz, nww, 4, 2);
-		l->mass[i].igneous = 1.2f + 1.5f * l->mass[i].igneous;
-		l->mass[i].sediment = 0.25f + 0.25f * opensimplex4(n[0], nx*sf, ny*sf, nz*sf, nw*sf);
-	}
-	for (size_t i = 0; i < LITHOSPHERE_AREA; ++ i) {
-		float total_mass = l->mass[i].sediment +
-		                   l->mass[i].metamorphic +
-		                   l->mass[i].igneous;
+		l->mass[i].sediment = 0.25f + 0.25f * rows[0][x];
+		float total_mass = mass_total(&l->mass[i]);
 		if (total_mass < TECTONIC_OCEAN_FLOOR_MASS)
 			l->mass[i].igneous = TECTONIC_OCEAN_FLOOR_MASS;
 		/* Erode to sediment relative to "shore height" */
@@ -482,9 +677,8 @@ lithosphere_init_mass(struct lithosphere *l)
 		float erode = CLAMP(1 - MIN(0.5f, d), 0, l->mass[i].igneous);
 		l->mass[i].sediment += erode;
 		l->mass[i].igneous -= erode;
+		l->total_mass[i] = mass_total(&l->mass[i]);
 	}
-	for (size_t i = 0; i < 5; ++ i)
-		free(n[i]);
 }
 
 static void
@@ -510,6 +704,7 @@ lithosphere_update_impl(struct lithosphere *l,
 	 */
 	memcpy(l->prev_owner, l->owner, LITHOSPHERE_AREA * sizeof(uint32_t));
 	memset(l->mass, 0, LITHOSPHERE_AREA * sizeof(*l->mass));
+	memset(l->total_mass, 0, LITHOSPHERE_AREA * sizeof(*l->total_mass));
 	memset(l->owner, 0xFF, LITHOSPHERE_AREA * sizeof(*l->owner));
 
 	/* Segment plates before creating collisions */
@@ -519,16 +714,15 @@ lithosphere_update_impl(struct lithosphere *l,
 		plate_segment(l->plates + pi, &sid_ter, opts);
 
 	/* Blit plate information to the lithosphere, identify collisions */
-	for (uint32_t pi = 0; pi < plate_count; ++ pi)
-		plate_blit(l, pi, opts);
+	lithosphere_blit_plates(l, opts);
 
 	/*
 	 * Resolve collisions. Note: this has not been packed away in its own
 	 * little function because I find it useful to eliminate duplicate
-	 * calls to segment_overlap using cache variables. TODO: The smarter
-	 * thing to do would be pre-process l->collisions to eliminate
-	 * duplicates before this point.
+	 * calls to segment_overlap using cache variables. Duplicates which
+	 * aren't consecutive hit the overlap memo instead.
 	 */
+	++ l->overlap_stamp;
 	struct segment *last_s0 = NULL, *last_s1 = NULL;
 	size_t collision_count = vector_size(l->collisions);
 	for (size_t i = 0; i < collision_count; ++ i) {
@@ -544,8 +738,8 @@ lithosphere_update_impl(struct lithosphere *l,
 		lithosphere_to_plate(p1, c->x, c->y, p1xy);
 		size_t i0 = p0xy[1] * LITHOSPHERE_LEN + p0xy[0];
 		size_t i1 = p1xy[1] * LITHOSPHERE_LEN + p1xy[0];
-		uint16_t si0 = p0->in_segment[i0];
-		uint16_t si1 = p1->in_segment[i1];
+		uint16_t si0 = plate_in_segment(p0, i0);
+		uint16_t si1 = plate_in_segment(p1, i1);
 		if (si0 != NO_SEGMENT && si1 != NO_SEGMENT) {
 			struct segment *s0 = p0->segments + si0;
 			struct segment *s1 = p1->segments + si1;
@@ -555,7 +749,7 @@ lithosphere_update_impl(struct lithosphere *l,
 			}
 			last_s0 = s0;
 			last_s1 = s1;
-			float overlap = segment_overlap(p0, p1, si0, si1);
+			float overlap = segment_overlap_memo(l, p0, p1, si0, si1);
 			float smaller_area = MIN(s0->area, s1->area);
 			/*
 			 * If our segments overlap more than some ratio, merge
@@ -600,30 +794,27 @@ plate_erode(struct plate *p, const struct world_opts *opts)
 	for (uint32_t x = 0; x < p->w;  ++ x) {
 		size_t i = wrap(p->top  + y) * LITHOSPHERE_LEN +
 			   wrap(p->left + x);
-		float h = p->mass[i].sediment +
-		          p->mass[i].metamorphic +
-		          p->mass[i].igneous;
+		struct plate_tile *t = plate_tile(p, i);
+		if (!t)
+			continue;
+		size_t c = tile_cell(i);
+		float h = t->total_mass[c];
 		if (h <= 0)
 			continue;
-		uint32_t ni[8] = {
-			wrap(p->top+y-1) * LITHOSPHERE_LEN + wrap(p->left+x-1),
-			wrap(p->top+y-1) * LITHOSPHERE_LEN + wrap(p->left+x+0),
-			wrap(p->top+y-1) * LITHOSPHERE_LEN + wrap(p->left+x+1),
-			wrap(p->top+y+0) * LITHOSPHERE_LEN + wrap(p->left+x-1),
-			wrap(p->top+y+0) * LITHOSPHERE_LEN + wrap(p->left+x+1),
-			wrap(p->top+y+1) * LITHOSPHERE_LEN + wrap(p->left+x-1),
-			wrap(p->top+y+1) * LITHOSPHERE_LEN + wrap(p->left+x+0),
-			wrap(p->top+y+1) * LITHOSPHERE_LEN + wrap(p->left+x+1)
-		};
-		float nh[8];
+		uint32_t ni[MOORE_NEIGHBORHOOD_SIZE];
+		moore_neighbors_pow2(ni, (long)p->left + x, (long)p->top + y,
+		                     LITHOSPHERE_SCALE);
+		float nh[MOORE_NEIGHBORHOOD_SIZE];
 		float talus = h < TECTONIC_CONTINENT_MASS
 		                ? opts->tectonic.ocean_talus
 		                : opts->tectonic.continent_talus;
-		for (size_t i = 0; i < 8; ++ i) {
-			size_t n = ni[i];
-			float nm = p->mass[n].sediment +
-			           p->mass[n].metamorphic +
-			           p->mass[n].igneous;
+		for (size_t i = 0; i < MOORE_NEIGHBORHOOD_SIZE; ++ i) {
+			/* Never erodes into itself, below */
+			if (i == MOORE_NEIGHBOR_C) {
+				nh[i] = 0;
+				continue;
+			}
+			float nm = plate_total_mass(p, ni[i]);
 			if (nm <= 0) {
 				nh[i] = 0;
 			}
@@ -638,7 +829,7 @@ plate_erode(struct plate *p, const struct world_opts *opts)
 		}
 		float dh = 0; /* delta to lowest neighbor */
 		float da = 0; /* accumulate deltas to all neighbors */
-		for (size_t i = 0; i < 8; ++ i) {
+		for (size_t i = 0; i < MOORE_NEIGHBORHOOD_SIZE; ++ i) {
 			if (nh[i] > 0) {
 				da += nh[i];
 				dh = MAX(dh, nh[i]);
@@ -652,12 +843,17 @@ plate_erode(struct plate *p, const struct world_opts *opts)
 		}
 		if (dh > FLT_EPSILON) {
 			/* Turn half into sediment, transport other half as sediment */
-			remove_mass(&p->mass[i], dh * 2);
-			p->mass[i].sediment += dh;
-			for (size_t i = 0; i < 8; ++ i) {
-				size_t n = ni[i];
-				if (nh[i] > 0)
-					p->mass[n].sediment += nh[i] * da;
+			remove_mass(&t->mass[c], &t->total_mass[c], dh * 2);
+			t->mass[c].sediment += dh;
+			t->total_mass[c] = mass_total(&t->mass[c]);
+			for (size_t i = 0; i < MOORE_NEIGHBORHOOD_SIZE; ++ i) {
+				if (nh[i] > 0) {
+					/* nh > 0 only where there's mass */
+					struct plate_tile *nt = plate_tile(p, ni[i]);
+					size_t nc = tile_cell(ni[i]);
+					nt->mass[nc].sediment += nh[i] * da;
+					nt->total_mass[nc] = mass_total(&nt->mass[nc]);
+				}
 			}
 		}
 
@@ -677,13 +873,16 @@ plate_collide(struct lithosphere *l,
 		uint32_t py = wrap((long)src_segment->top  + sy);
 		uint32_t px = wrap((long)src_segment->left + sx);
 		size_t pi = py * LITHOSPHERE_LEN + px;
-		if (src->in_segment[pi] == src_si) {
+		struct plate_tile *t = plate_tile(src, pi);
+		size_t c = tile_cell(pi);
+		if (t && t->in_segment[c] == src_si) {
 			uint32_t wxy[2];
 			plate_to_lithosphere(src, px, py, wxy);
-			plate_cell_collision(dst, wxy[0], wxy[1], src->mass[pi], dst_si);
+			plate_cell_collision(dst, wxy[0], wxy[1], t->mass[c], dst_si);
 			l->owner[wxy[1] * LITHOSPHERE_LEN + wxy[0]] = dst_pi;
-			src->mass[pi] = (struct tectonic_mass_composition) { 0 };
-			src->in_segment[pi] = NO_SEGMENT;
+			t->mass[c] = (struct tectonic_mass_composition) { 0 };
+			t->total_mass[c] = 0;
+			t->in_segment[c] = NO_SEGMENT;
 		}
 	}
 	/*
@@ -691,6 +890,18 @@ plate_collide(struct lithosphere *l,
 	 * indices. Just zero area.
 	 */
 	src->segments[src_si].area = 0;
+
+	/*
+	 * Any segment of either plate may have changed shape, so drop their
+	 * bitmaps and every memoized overlap.
+	 */
+	size_t src_segment_count = vector_size(src->segments);
+	for (size_t si = 0; si < src_segment_count; ++ si)
+		src->segments[si].occupancy = NO_OCCUPANCY;
+	size_t dst_segment_count = vector_size(dst->segments);
+	for (size_t si = 0; si < dst_segment_count; ++ si)
+		dst->segments[si].occupancy = NO_OCCUPANCY;
+	++ l->overlap_stamp;
 }
 
 static uint32_t
@@ -712,51 +923,171 @@ segment_overlap(struct plate *p0, struct plate *p1, uint16_t si0, uint16_t si1)
 	uint32_t y0 = MIN(tl_p0[1], tl_p1[1]);
 	uint32_t y1 = MIN(br_p0[1], br_p1[1]);
 	uint32_t overlap = 0;
-	for (uint32_t y = y0; y != y1; y = wrap((long)y+1))
-	for (uint32_t x = x0; x != x1; x = wrap((long)x+1)) {
-		uint32_t p0xy[2];
-		uint32_t p1xy[2];
-		lithosphere_to_plate(p0, x, y, p0xy);
-		lithosphere_to_plate(p1, x, y, p1xy);
-		size_t src0 = p0xy[1] * LITHOSPHERE_LEN + p0xy[0];
-		size_t src1 = p1xy[1] * LITHOSPHERE_LEN + p1xy[0];
-		if (p0->in_segment[src0] == si0 && p1->in_segment[src1] == si1)
-			++ overlap;
+
+	if (s0->spilled || s1->spilled) {
+		for (uint32_t y = y0; y != y1; y = wrap((long)y+1))
+		for (uint32_t x = x0; x != x1; x = wrap((long)x+1)) {
+			size_t src0 = p0->blit_py[y] * LITHOSPHERE_LEN + p0->blit_px[x];
+			size_t src1 = p1->blit_py[y] * LITHOSPHERE_LEN + p1->blit_px[x];
+			if (plate_in_segment(p0, src0) == si0 &&
+			    plate_in_segment(p1, src1) == si1)
+				++ overlap;
+		}
+		return overlap;
+	}
+
+	segment_occupancy(p0, si0);
+	segment_occupancy(p1, si1);
+	const uint64_t *bits0 = p0->occupancy + s0->occupancy;
+	const uint64_t *bits1 = p1->occupancy + s1->occupancy;
+	size_t stride0 = (s0->w + 63) / 64;
+	size_t stride1 = (s1->w + 63) / 64;
+
+	/*
+	 * Segment relative plate columns of each lithosphere column. Rounding
+	 * and wrapping break these into runs where the columns of both plates
+	 * advance one at a time, which we can AND together 64 at a time.
+	 */
+	uint32_t rx0[LITHOSPHERE_LEN];
+	uint32_t rx1[LITHOSPHERE_LEN];
+	uint32_t run_end[LITHOSPHERE_LEN];
+	uint32_t width = wrap((long)x1 - x0);
+	uint32_t height = wrap((long)y1 - y0);
+	for (uint32_t k = 0; k < width; ++ k) {
+		uint32_t x = wrap((long)x0 + k);
+		rx0[k] = wrap((long)p0->blit_px[x] - s0->left);
+		rx1[k] = wrap((long)p1->blit_px[x] - s1->left);
+	}
+	for (uint32_t k = width, end = width; k -- > 0; ) {
+		if (k + 1 < width && (rx0[k+1] != rx0[k] + 1 ||
+		                      rx1[k+1] != rx1[k] + 1))
+		{
+			end = k + 1;
+		}
+		run_end[k] = end;
+	}
+
+	for (uint32_t k = 0; k < height; ++ k) {
+		uint32_t y = wrap((long)y0 + k);
+		uint32_t ry0 = wrap((long)p0->blit_py[y] - s0->top);
+		uint32_t ry1 = wrap((long)p1->blit_py[y] - s1->top);
+		if (ry0 >= s0->h || ry1 >= s1->h)
+			continue;
+		const uint64_t *row0 = bits0 + ry0 * stride0;
+		const uint64_t *row1 = bits1 + ry1 * stride1;
+		for (uint32_t j = 0; j < width; ) {
+			unsigned n = MIN(run_end[j] - j, 64);
+			overlap += popcount64(occupancy_bits(row0, s0->w, rx0[j], n) &
+			                      occupancy_bits(row1, s1->w, rx1[j], n));
+			j += n;
+		}
 	}
 	return overlap;
 }
 
+static uint32_t
+segment_overlap_memo(struct lithosphere *l,
+                     struct plate *p0, struct plate *p1,
+                     uint16_t si0, uint16_t si1)
+{
+	uint32_t key = (uint32_t)p0->segments[si0].id << 16 |
+	               p1->segments[si1].id;
+	/* Fibonacci hashing, the high bits of the product are the well mixed ones */
+	size_t h = (uint32_t)(key * 2654435761u) >> (32 - OVERLAP_MEMO_BITS);
+	/* Don't probe far, just calculate overlap if the memo is that full */
+	for (size_t probe = 0; probe < 16; ++ probe) {
+		struct overlap_memo *m = l->overlap_memo +
+		                         (h + probe) % OVERLAP_MEMO_SIZE;
+		if (m->stamp != l->overlap_stamp) {
+			m->key = key;
+			m->stamp = l->overlap_stamp;
+			m->overlap = segment_overlap(p0, p1, si0, si1);
+			return m->overlap;
+		}
+		if (m->key == key)
+			return m->overlap;
+	}
+	return segment_overlap(p0, p1, si0, si1);
+}
+
+static void
+segment_occupancy(struct plate *p, uint16_t si)
+{
+	struct segment *s = p->segments + si;
+	if (s->occupancy != NO_OCCUPANCY)
+		return;
+	size_t stride = (s->w + 63) / 64;
+	s->occupancy = vector_size(p->occupancy);
+	for (size_t i = 0; i < stride * s->h; ++ i)
+		vector_push(&p->occupancy, 0);
+	uint64_t *bits = p->occupancy + s->occupancy;
+	for (uint32_t y = 0; y < s->h; ++ y)
+	for (uint32_t x = 0; x < s->w; ++ x) {
+		size_t i = wrap((long)s->top  + y) * LITHOSPHERE_LEN +
+		           wrap((long)s->left + x);
+		if (plate_in_segment(p, i) == si)
+			bits[y * stride + x / 64] |= (uint64_t)1 << (x % 64);
+	}
+}
+
+static uint64_t
+occupancy_bits(const uint64_t *row, uint32_t w, uint32_t x, unsigned n)
+{
+	if (x >= w)
+		return 0;
+	size_t word = x / 64;
+	unsigned shift = x % 64;
+	uint64_t bits = row[word] >> shift;
+	if (shift && word + 1 < (w + 63) / 64)
+		bits |= row[word + 1] << (64 - shift);
+	if (n < 64)
+		bits &= ((uint64_t)1 << n) - 1;
+	return bits;
+}
+
 static void
 plate_blit(struct lithosphere *l, uint32_t pi,
+           uint32_t y0, uint32_t y1,
+           struct collision **collisions,
+           uint16_t **segment_pairs,
+           uint8_t collision_set[COLLISION_SET_BYTES],
            const struct world_opts *opts)
 {
 	struct plate *p = l->plates + pi;
-	for (uint32_t y = 0; y < LITHOSPHERE_LEN; ++ y)
+	for (uint32_t y = y0; y < y1; ++ y)
 	for (uint32_t x = 0; x < LITHOSPHERE_LEN; ++ x) {
-		uint32_t pxy[2];
-		lithosphere_to_plate(p, x, y, pxy);
+		size_t src = p->blit_py[y] * LITHOSPHERE_LEN + p->blit_px[x];
+		struct plate_tile *t = plate_tile(p, src);
+		if (!t) {
+			/* Skip every column mapping onto this missing tile */
+			x = p->blit_run_end[x] - 1;
+			continue;
+		}
 		size_t dst = y * LITHOSPHERE_LEN + x;
-		size_t src = pxy[1] * LITHOSPHERE_LEN + pxy[0];
-		float src_total_mass = p->mass[src].sediment +
-		                       p->mass[src].metamorphic +
-		                       p->mass[src].igneous;
-		float dst_total_mass = l->mass[dst].sediment +
-		                       l->mass[dst].metamorphic +
-		                       l->mass[dst].igneous;
+		src = tile_cell(src);
+		float src_total_mass = t->total_mass[src];
+		float dst_total_mass = l->total_mass[dst];
 		if (src_total_mass <= 0)
 			continue;
 
 		if (l->owner[dst] == NO_PLATE) {
 			/* No collision! Claim this cell */
 			l->owner[dst] = pi;
-			l->mass[dst] = p->mass[src];
+			l->mass[dst] = t->mass[src];
+			l->total_mass[dst] = t->total_mass[src];
 			continue;
 		}
 
+		/*
+		 * The previous owner had mass here when it claimed this cell,
+		 * so its tile must exist.
+		 */
 		struct plate *prev_plate = l->plates + l->owner[dst];
-		uint32_t pvxy[2];
-		lithosphere_to_plate(prev_plate, x, y, pvxy);
-		size_t prev_src = pvxy[1] * LITHOSPHERE_LEN + pvxy[0];
+		size_t prev_src = prev_plate->blit_py[y] * LITHOSPHERE_LEN +
+		                  prev_plate->blit_px[x];
+		struct plate_tile *pt = plate_tile(prev_plate, prev_src);
+		assert(pt);
+		prev_src = tile_cell(prev_src);
 
 		/*
 		 * Oceanic-oceanic subduction. This plate has less
@@ -767,15 +1098,17 @@ plate_blit(struct lithosphere *l, uint32_t pi,
 		{
 			float xfer = MAX(MIN_XFER, opts->tectonic.subduction_xfer * src_total_mass);
 			/* Remove transferred mass from source */
-			remove_mass(&p->mass[src], xfer);
+			remove_mass(&t->mass[src], &t->total_mass[src], xfer);
 			src_total_mass -= xfer;
 			/* Add transferred mass to receiver as igneous */
 			dst_total_mass += xfer;
-			prev_plate->mass[prev_src].igneous += xfer;
+			pt->mass[prev_src].igneous += xfer;
+			pt->total_mass[prev_src] = mass_total(&pt->mass[prev_src]);
 			l->mass[dst].igneous += xfer;
+			l->total_mass[dst] = mass_total(&l->mass[dst]);
 
 			if (src_total_mass <= 0) {
-				p->in_segment[src] = NO_SEGMENT;
+				t->in_segment[src] = NO_SEGMENT;
 				continue;
 			}
 		}
@@ -788,18 +1121,20 @@ plate_blit(struct lithosphere *l, uint32_t pi,
 		else if (dst_total_mass < TECTONIC_CONTINENT_MASS) {
 			float xfer = MAX(MIN_XFER, opts->tectonic.subduction_xfer * dst_total_mass);
 			/* Remove transferred mass from source */
-			remove_mass(&prev_plate->mass[prev_src], xfer);
-			remove_mass(&l->mass[dst], xfer);
+			remove_mass(&pt->mass[prev_src], &pt->total_mass[prev_src], xfer);
+			remove_mass(&l->mass[dst], &l->total_mass[dst], xfer);
 			dst_total_mass -= xfer;
 			/* Add transferred mass to receiver as igneous */
 			src_total_mass += xfer;
-			p->mass[src].igneous += xfer;
+			t->mass[src].igneous += xfer;
+			t->total_mass[src] = mass_total(&t->mass[src]);
 
 			/* If last plate is gone, claim cell */
 			if (dst_total_mass <= 0) {
-				prev_plate->in_segment[prev_src] = NO_SEGMENT;
+				pt->in_segment[prev_src] = NO_SEGMENT;
 				l->owner[dst] = pi;
-				l->mass[dst] = p->mass[src];
+				l->mass[dst] = t->mass[src];
+				l->total_mass[dst] = t->total_mass[src];
 				continue;
 			}
 		}
@@ -809,14 +1144,16 @@ plate_blit(struct lithosphere *l, uint32_t pi,
 		 */
 		else {
 			float xfer = MAX(MIN_XFER, opts->tectonic.collision_xfer * src_total_mass);
-			remove_mass(&p->mass[src], xfer);
+			remove_mass(&t->mass[src], &t->total_mass[src], xfer);
 			src_total_mass -= xfer;
-			prev_plate->mass[prev_src].metamorphic += xfer;
+			pt->mass[prev_src].metamorphic += xfer;
+			pt->total_mass[prev_src] = mass_total(&pt->mass[prev_src]);
 			l->mass[dst].metamorphic += xfer;
+			l->total_mass[dst] = mass_total(&l->mass[dst]);
 			dst_total_mass += xfer;
 
 			if (src_total_mass <= 0) {
-				p->in_segment[src] = NO_SEGMENT;
+				t->in_segment[src] = NO_SEGMENT;
 				continue;
 			}
 		}
@@ -824,28 +1161,60 @@ plate_blit(struct lithosphere *l, uint32_t pi,
 		 * Record a collision between the segment owning this cell and
 		 * this segment.
 		 */
-		uint16_t siA = p->in_segment[src];
-		uint16_t siB = prev_plate->in_segment[prev_src];
+		uint16_t siA = t->in_segment[src];
+		uint16_t siB = pt->in_segment[prev_src];
 		if (siA != NO_SEGMENT && siB != NO_SEGMENT) {
 			uint16_t si0 = siA < siB ? siA : siB;
 			uint16_t si1 = siA < siB ? siB : siA;
 			uint16_t cs = si0 * MAX_SEGMENT_COUNT + si1;
 			unsigned char m = 1 << (cs % 8);
-			if (l->collision_set[cs / 8] & m)
+			if (collision_set[cs / 8] & m)
 				continue;
-			l->collision_set[cs / 8] |= m;
-			vector_push(&l->collisions, (struct collision) {
+			collision_set[cs / 8] |= m;
+			vector_push(collisions, (struct collision) {
 				.plate_index = pi,
 				.x = x, .y = y
 			});
+			if (segment_pairs)
+				vector_push(segment_pairs, cs);
+		}
+	}
+}
+
+static int
+plate_blit_map(struct plate *p)
+{
+	uint8_t mapped[LITHOSPHERE_LEN / 8] = { 0 };
+	int rows_alias = 0;
+	for (uint32_t i = 0; i < LITHOSPHERE_LEN; ++ i) {
+		uint32_t pxy[2];
+		lithosphere_to_plate(p, i, i, pxy);
+		p->blit_px[i] = pxy[0];
+		p->blit_py[i] = pxy[1];
+		unsigned char m = 1 << (pxy[1] % 8);
+		if (mapped[pxy[1] / 8] & m)
+			rows_alias = 1;
+		mapped[pxy[1] / 8] |= m;
+	}
+	uint32_t run_end = LITHOSPHERE_LEN;
+	for (uint32_t x = LITHOSPHERE_LEN; x -- > 0; ) {
+		if (x + 1 < LITHOSPHERE_LEN &&
+		    p->blit_px[x] / PLATE_TILE_LEN != p->blit_px[x+1] / PLATE_TILE_LEN)
+		{
+			run_end = x + 1;
 		}
+		p->blit_run_end[x] = run_end;
 	}
+	return rows_alias;
 }
 
 static void
 plate_destroy(struct plate *p)
 {
 	vector_free(&p->segments);
+	vector_free(&p->occupancy);
+	for (size_t ti = 0; ti < PLATE_TILES_AREA; ++ ti)
+		free(p->tiles[ti]);
 }
 
 static void
@@ -882,23 +1251,34 @@ plate_cell_collision(struct plate *p, uint32_t wx, uint32_t wy,
 	}
 
 	/* Add mass */
-	if (p->in_segment[i] != NO_SEGMENT) {
+	struct plate_tile *t = plate_tile_alloc(p, i);
+	size_t c = tile_cell(i);
+	if (t->in_segment[c] != NO_SEGMENT) {
 		/* Arbitrary ratios for collision transformation */
 		float total_mass_xfer = m.sediment +
 					m.metamorphic +
 					m.igneous;
-		p->mass[i].sediment    += 0.1f * total_mass_xfer;
-		p->mass[i].metamorphic += 0.7f * total_mass_xfer;
-		p->mass[i].igneous     += 0.2f * total_mass_xfer;
+		t->mass[c].sediment    += 0.1f * total_mass_xfer;
+		t->mass[c].metamorphic += 0.7f * total_mass_xfer;
+		t->mass[c].igneous     += 0.2f * total_mass_xfer;
 	} else {
-		p->mass[i] = m;
+		t->mass[c] = m;
 	}
-	if (p->in_segment[i] != si) {
-		if (p->in_segment[i] != NO_SEGMENT)
-			-- p->segments[p->in_segment[i]].area;
-		if (si != NO_SEGMENT)
-			++ p->segments[si].area;
-		p->in_segment[i] = si;
+	t->total_mass[c] = mass_total(&t->mass[c]);
+	if (t->in_segment[c] != si) {
+		if (t->in_segment[c] != NO_SEGMENT)
+			-- p->segments[t->in_segment[c]].area;
+		if (si != NO_SEGMENT) {
+			struct segment *s = p->segments + si;
+			++ s->area;
+			/* Segments don't grow, see segment::spilled */
+			if (wrap((long)pxy[0] - s->left) >= s->w ||
+			    wrap((long)pxy[1] - s->top)  >= s->h)
+			{
+				s->spilled = 1;
+			}
+		}
+		t->in_segment[c] = si;
 	}
 }
 
@@ -922,14 +1302,13 @@ plate_growbfs_segment(struct plate *p, uint32_t **bfs, uint16_t si,
 			uint32_t py = wrap(srcy + yy);
 			uint32_t px = wrap(srcx + xx);
 			uint32_t neighbor = py * LITHOSPHERE_LEN + px;
-			float neighbor_mass = p->mass[neighbor].sediment +
-			                      p->mass[neighbor].metamorphic +
-			                      p->mass[neighbor].igneous;
-			if (p->in_segment[neighbor] == NO_SEGMENT &&
-			    neighbor_mass >= TECTONIC_CONTINENT_MASS)
+			float neighbor_mass = plate_total_mass(p, neighbor);
+			if (neighbor_mass >= TECTONIC_CONTINENT_MASS &&
+			    plate_in_segment(p, neighbor) == NO_SEGMENT)
 			{
 				/* claim and mark as new source */
-				p->in_segment[neighbor] = si;
+				struct plate_tile *t = plate_tile(p, neighbor);
+				t->in_segment[tile_cell(neighbor)] = si;
 				ring_push(bfs, neighbor);
 				/* grow segment area and dimensions */
 				struct segment *s = p->segments + si;
@@ -983,7 +1362,13 @@ plate_segment(struct plate *p, uint16_t *sid_ter,
               const struct world_opts *opts)
 {
 	vector_clear(&p->segments);
-	memset(p->in_segment, 0xFF, LITHOSPHERE_AREA * sizeof(*p->in_segment));
+	vector_clear(&p->occupancy);
+	for (size_t ti = 0; ti < PLATE_TILES_AREA; ++ ti) {
+		if (p->tiles[ti]) {
+			memset(p->tiles[ti]->in_segment, 0xFF,
+			       sizeof(p->tiles[ti]->in_segment));
+		}
+	}
 
 	uint32_t *bfs = NULL;
 
@@ -991,11 +1376,9 @@ plate_segment(struct plate *p, uint16_t *sid_ter,
 	for (uint32_t x = 0; x < p->w;  ++ x) {
 		size_t i = wrap(p->top  + y) * LITHOSPHERE_LEN +
 			   wrap(p->left + x);
-		float total_mass = p->mass[i].sediment +
-		                   p->mass[i].metamorphic +
-		                   p->mass[i].igneous;
-		if (p->in_segment[i] != NO_SEGMENT ||
-		    total_mass < TECTONIC_CONTINENT_MASS)
+		float total_mass = plate_total_mass(p, i);
+		if (total_mass < TECTONIC_CONTINENT_MASS ||
+		    plate_in_segment(p, i) != NO_SEGMENT)
 		{
 			continue;
 		}
@@ -1010,10 +1393,11 @@ plate_segment(struct plate *p, uint16_t *sid_ter,
 			.top  = p->top  + y,
 			.w    = 1,
 			.h    = 1,
+			.occupancy = NO_OCCUPANCY,
 			.id   = ++ *sid_ter
 		});
 		/* Claim first cell */
-		p->in_segment[i] = si;
+		plate_tile(p, i)->in_segment[tile_cell(i)] = si;
 		/* Perform breadth-first search */
 		ring_push(&bfs, i);
 		plate_growbfs_segment(p, &bfs, si, opts);
@@ -1055,18 +1439,21 @@ plate_set_mass(struct plate *p, uint32_t wx, uint32_t wy,
 		p->h = LITHOSPHERE_LEN;
 	}
 
-	p->mass[i] = m;
-	if (p->in_segment[i] != si) {
-		if (p->in_segment[i] != NO_SEGMENT)
-			-- p->segments[p->in_segment[i]].area;
+	struct plate_tile *t = plate_tile_alloc(p, i);
+	size_t c = tile_cell(i);
+	t->mass[c] = m;
+	t->total_mass[c] = mass_total(&m);
+	if (t->in_segment[c] != si) {
+		if (t->in_segment[c] != NO_SEGMENT)
+			-- p->segments[t->in_segment[c]].area;
 		if (si != NO_SEGMENT)
 			++ p->segments[si].area;
-		p->in_segment[i] = si;
+		t->in_segment[c] = si;
 	}
 }
 
 static void
-remove_mass(struct tectonic_mass_composition *m, float remove)
+remove_mass(struct tectonic_mass_composition *m, float *total, float remove)
 {
 	/* Remove from sediment first, etc. */
 	float rs = MIN(m->sediment, remove);
@@ -1075,4 +1462,11 @@ remove_mass(struct tectonic_mass_composition *m, float remove)
 	if (rs) m->sediment    -= rs;
 	if (rm) m->metamorphic -= rm;
 	if (ri) m->igneous     -= ri;
+	*total = mass_total(m);
+}
+
+static float
+mass_total(const struct tectonic_mass_composition *m)
+{
+	return m->sediment + m->metamorphic + m->igneous;
 }